@@ -0,0 +1,44 @@
+#pragma once
+
+//Standard includes
+#include <chrono>
+#include <future>
+#include <memory>
+
+#include "ThreadPool.h"
+
+namespace dae
+{
+	//runs asset loads on threads of its own, so they never queue up in front of a frame's ParallelFor
+	//Load returns right away with a future, the owner polls it between frames and swaps the asset in once it is there
+	class AssetLoader final
+	{
+	public:
+		//the pool counts the thread that calls ParallelFor, submitted loads only run on its workers
+		explicit AssetLoader(uint32_t threadCount) :
+			m_Pool{ threadCount + 1 }
+		{
+		}
+
+		template<typename LoadFunction>
+		auto Load(LoadFunction&& load) -> std::future<decltype(load())>
+		{
+			//a std::function has to be copyable, the task isn't, so the job holds it through a shared_ptr
+			using Result = decltype(load());
+			const auto pTask{ std::make_shared<std::packaged_task<Result()>>(std::forward<LoadFunction>(load)) };
+			std::future<Result> result{ pTask->get_future() };
+			m_Pool.Submit([pTask]() { (*pTask)(); });
+			return result;
+		}
+
+		//never blocks, false for a future that was already taken
+		template<typename Result>
+		static bool IsReady(const std::future<Result>& future)
+		{
+			return future.valid() && future.wait_for(std::chrono::seconds{ 0 }) == std::future_status::ready;
+		}
+
+	private:
+		ThreadPool m_Pool;
+	};
+}
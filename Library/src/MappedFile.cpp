@@ -0,0 +1,82 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dae
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& path, Access access)
+	{
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (m_File == INVALID_HANDLE_VALUE)
+		{
+			m_File = nullptr;
+			return;
+		}
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(m_File, &size)) return;
+		m_Size = static_cast<size_t>(size.QuadPart);
+
+		//a mapping of 0 bytes can't be made, an empty file just has no data
+		if (m_Size == 0)
+		{
+			m_IsOpen = true;
+			return;
+		}
+
+		m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_Mapping == nullptr) return;
+
+		m_pData = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		m_IsOpen = m_pData != nullptr;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_pData != nullptr) UnmapViewOfFile(m_pData);
+		if (m_Mapping != nullptr) CloseHandle(m_Mapping);
+		if (m_File != nullptr) CloseHandle(m_File);
+	}
+#else
+	MappedFile::MappedFile(const std::string& path, Access access)
+	{
+		m_File = open(path.c_str(), O_RDONLY);
+		if (m_File < 0) return;
+
+		struct stat status{};
+		if (fstat(m_File, &status) != 0) return;
+		m_Size = static_cast<size_t>(status.st_size);
+
+		//a mapping of 0 bytes can't be made, an empty file just has no data
+		if (m_Size == 0)
+		{
+			m_IsOpen = true;
+			return;
+		}
+
+		void* pMapping{ mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0) };
+		if (pMapping == MAP_FAILED) return;
+
+		madvise(pMapping, m_Size, access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+		m_pData = static_cast<const char*>(pMapping);
+		m_IsOpen = true;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_pData != nullptr) munmap(const_cast<char*>(m_pData), m_Size);
+		if (m_File >= 0) close(m_File);
+	}
+#endif
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+//Standard includes
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	//read only memory mapping of a whole file, the OS pages it in on demand instead of copying it through a stream
+	class MappedFile final
+	{
+	public:
+		//how the pages will be touched, sequential lets the OS read ahead, random keeps it to the pages that get used
+		enum class Access
+		{
+			Sequential,
+			Random
+		};
+
+		explicit MappedFile(const std::string& path, Access access = Access::Sequential);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		//an empty file is open but has no data
+		bool IsOpen() const { return m_IsOpen; }
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const char* m_pData{};
+		size_t m_Size{};
+		bool m_IsOpen{ false };
+
+#ifdef _WIN32
+		void* m_File{};
+		void* m_Mapping{};
+#else
+		int m_File{ -1 };
+#endif
+	};
+}
@@ -0,0 +1,167 @@
+#include "MeshCache.h"
+#include "SourceStamp.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace dae
+{
+	struct MeshCache::Header
+	{
+		char magic[8]{};
+		uint32_t version{};
+		uint32_t componentCount{}; //VertexInLayout::ComponentCount when it was written
+		SourceStamp source{};
+		uint64_t vertexCount{};
+		uint64_t vertexCapacity{}; //elements per component array, a multiple of the stream's block size
+		uint64_t indexCount{};
+		uint64_t vertexOffset{}; //from the start of the file, 32 byte aligned like the stream's own arrays
+		uint64_t indexOffset{};
+		uint32_t primitiveTopology{};
+		float boundsMin[3]{};
+		float boundsMax[3]{};
+		VertexQuantization quantization{};
+	};
+
+	namespace
+	{
+		constexpr char g_Magic[8]{ 'D', 'A', 'E', 'M', 'E', 'S', 'H', '\0' };
+		constexpr uint64_t g_StreamAlignment{ 32 };
+	}
+
+	MeshCache::MeshCache(const std::string& path, const std::string& sourcePath) :
+		m_File{ path }
+	{
+		if (!m_File.IsOpen() || m_File.GetSize() < sizeof(Header)) return;
+
+		//the mapping is page aligned, so the header and the 32 byte aligned streams are too
+		const Header* pHeader{ reinterpret_cast<const Header*>(m_File.GetData()) };
+		if (std::memcmp(pHeader->magic, g_Magic, sizeof(g_Magic)) != 0
+			|| pHeader->version != Version
+			|| pHeader->componentCount != VertexInLayout::ComponentCount)
+			return;
+
+		//everything the header points at has to be inside the file
+		const uint64_t vertexBytes{ pHeader->vertexCapacity * VertexInLayout::ComponentCount * sizeof(VertexInLayout::Element) };
+		if (pHeader->vertexCapacity % VertexInStream::BlockSize != 0 || pHeader->vertexCount > pHeader->vertexCapacity
+			|| pHeader->vertexCount > std::numeric_limits<uint32_t>::max()
+			|| pHeader->vertexOffset % g_StreamAlignment != 0 || pHeader->vertexOffset + vertexBytes > m_File.GetSize()
+			|| pHeader->indexOffset % sizeof(uint32_t) != 0 || pHeader->indexOffset + pHeader->indexCount * sizeof(uint32_t) > m_File.GetSize()
+			|| pHeader->primitiveTopology > static_cast<uint32_t>(PrimitiveTopology::TriangleStrip))
+			return;
+
+		//and every index has to name a vertex, the binner reads them unchecked, one pass over the index pages
+		const uint32_t* pIndices{ reinterpret_cast<const uint32_t*>(m_File.GetData() + pHeader->indexOffset) };
+		uint32_t maxIndex{};
+		for (uint64_t i{}; i < pHeader->indexCount; ++i)
+		{
+			maxIndex = std::max(maxIndex, pIndices[i]);
+		}
+		if (pHeader->indexCount != 0 && maxIndex >= pHeader->vertexCount) return;
+
+		if (!MatchesSourceStamp(sourcePath, pHeader->source)) return;
+
+		m_pHeader = pHeader;
+	}
+
+	void MeshCache::ViewVertices(VertexInStream& stream) const
+	{
+		stream.View(reinterpret_cast<const VertexInLayout::Element*>(m_File.GetData() + m_pHeader->vertexOffset), m_pHeader->vertexCount, m_pHeader->vertexCapacity);
+	}
+
+	const uint32_t* MeshCache::GetIndices() const
+	{
+		return reinterpret_cast<const uint32_t*>(m_File.GetData() + m_pHeader->indexOffset);
+	}
+
+	size_t MeshCache::GetIndexCount() const
+	{
+		return m_pHeader->indexCount;
+	}
+
+	PrimitiveTopology MeshCache::GetPrimitiveTopology() const
+	{
+		return static_cast<PrimitiveTopology>(m_pHeader->primitiveTopology);
+	}
+
+	Vector3 MeshCache::GetBoundsMin() const
+	{
+		return Vector3{ m_pHeader->boundsMin[0], m_pHeader->boundsMin[1], m_pHeader->boundsMin[2] };
+	}
+
+	Vector3 MeshCache::GetBoundsMax() const
+	{
+		return Vector3{ m_pHeader->boundsMax[0], m_pHeader->boundsMax[1], m_pHeader->boundsMax[2] };
+	}
+
+	const VertexQuantization& MeshCache::GetQuantization() const
+	{
+		return m_pHeader->quantization;
+	}
+
+	bool MeshCache::Write(const std::string& path, const std::string& sourcePath, const VertexInStream& vertices, const VertexQuantization& quantization, const std::vector<uint32_t>& indices, PrimitiveTopology topology)
+	{
+		using C = VertexInLayout;
+
+		Header header{};
+		std::memcpy(header.magic, g_Magic, sizeof(g_Magic));
+		header.version = Version;
+		header.componentCount = C::ComponentCount;
+
+		header.source = MakeSourceStamp(sourcePath);
+
+		//only the padded count gets written, the stream's own allocation can be bigger
+		const size_t count{ vertices.GetCount() };
+		header.vertexCount = count;
+		header.vertexCapacity = (count + VertexInStream::BlockSize - 1) / VertexInStream::BlockSize * VertexInStream::BlockSize;
+		header.indexCount = indices.size();
+		header.vertexOffset = (sizeof(Header) + g_StreamAlignment - 1) / g_StreamAlignment * g_StreamAlignment;
+		header.indexOffset = header.vertexOffset + header.vertexCapacity * C::ComponentCount * sizeof(C::Element);
+		header.primitiveTopology = static_cast<uint32_t>(topology);
+		header.quantization = quantization;
+
+		//bounds of the positions as the vertex stage decodes them, not of the source floats
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const C::Element* pPositions{ vertices.Get(C::PositionX + axis) };
+			C::Element min{ count != 0 ? pPositions[0] : C::Element{} };
+			C::Element max{ min };
+			for (size_t i{ 1 }; i < count; ++i)
+			{
+				min = std::min(min, pPositions[i]);
+				max = std::max(max, pPositions[i]);
+			}
+			const float offset{ quantization.offset[C::PositionX + axis] };
+			const float scale{ quantization.scale[C::PositionX + axis] };
+			header.boundsMin[axis] = float(min) * scale + offset;
+			header.boundsMax[axis] = float(max) * scale + offset;
+		}
+
+		const std::string tempPath{ path + ".tmp" };
+		{
+			std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+			if (!file) return false;
+
+			const char padding[g_StreamAlignment]{};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			file.write(padding, header.vertexOffset - sizeof(Header));
+			for (int component{}; component < C::ComponentCount; ++component)
+			{
+				file.write(reinterpret_cast<const char*>(vertices.Get(component)), header.vertexCapacity * sizeof(C::Element));
+			}
+			file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+			if (!file) return false;
+		}
+
+		std::error_code error{};
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "DataTypes.h"
+#include "MappedFile.h"
+#include "VertexStream.h"
+
+namespace dae
+{
+	//binary mesh file with the vertex streams and indices exactly as the renderer reads them, tangents and bounds included
+	//opening one maps it and points into the mapping, nothing is parsed or copied and pages come in as the vertex stage touches them
+	//the header remembers the source it was built from, a cache of an older version or of a changed source is not valid
+	//neither is one whose header or indices point outside of it, only the index pages get read while opening
+	class MeshCache final
+	{
+	public:
+		//bump when the file layout or anything that goes into it (parser, optimizer) changes
+		static constexpr uint32_t Version{ 3 };
+
+		//sourcePath may be missing, a cache without its source is used as is
+		MeshCache(const std::string& path, const std::string& sourcePath);
+		~MeshCache() = default;
+
+		MeshCache(const MeshCache&) = delete;
+		MeshCache(MeshCache&&) noexcept = delete;
+		MeshCache& operator=(const MeshCache&) = delete;
+		MeshCache& operator=(MeshCache&&) noexcept = delete;
+
+		bool IsValid() const { return m_pHeader != nullptr; }
+
+		//stream views into the mapping, only valid while the cache lives
+		void ViewVertices(VertexInStream& stream) const;
+		const uint32_t* GetIndices() const;
+		size_t GetIndexCount() const;
+		PrimitiveTopology GetPrimitiveTopology() const;
+		Vector3 GetBoundsMin() const;
+		Vector3 GetBoundsMax() const;
+		const VertexQuantization& GetQuantization() const;
+
+		//writes next to path first and renames it over, so a cache that is being written is never mapped
+		static bool Write(const std::string& path, const std::string& sourcePath, const VertexInStream& vertices, const VertexQuantization& quantization, const std::vector<uint32_t>& indices, PrimitiveTopology topology);
+
+	private:
+		struct Header;
+
+		MappedFile m_File;
+		const Header* m_pHeader{};
+	};
+}
@@ -0,0 +1,290 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	namespace
+	{
+		//Forsyth's tuning, an LRU cache of 32 with a bonus for the last triangle and for vertices with few triangles left
+		constexpr int g_ForsythCacheSize{ 32 };
+		constexpr float g_CacheDecayPower{ 1.5f };
+		constexpr float g_LastTriangleScore{ 0.75f };
+		constexpr float g_ValenceBoostScale{ 2.f };
+		constexpr float g_ValenceBoostPower{ 0.5f };
+
+		float ForsythVertexScore(int cachePosition, uint32_t remainingTriangles)
+		{
+			//nothing left to draw with this vertex
+			if (remainingTriangles == 0) return -1.f;
+
+			float score{ 0.f };
+			if (cachePosition >= 0)
+			{
+				//the three vertices of the last triangle get a fixed score so the next one doesn't just reuse its edge
+				if (cachePosition < 3) score = g_LastTriangleScore;
+				else
+				{
+					const float scaler{ 1.f / (g_ForsythCacheSize - 3) };
+					score = std::pow(1.f - (cachePosition - 3) * scaler, g_CacheDecayPower);
+				}
+			}
+
+			//finish off vertices with few triangles left, they would cost a miss later on
+			return score + g_ValenceBoostScale * std::pow(float(remainingTriangles), -g_ValenceBoostPower);
+		}
+
+		//FIFO post-transform cache, a vertex is in it until cacheSize misses happened after its own
+		class FifoCache final
+		{
+		public:
+			FifoCache(size_t vertexCount, int cacheSize) :
+				m_Stamps(vertexCount, 0),
+				m_CacheSize{ uint32_t(cacheSize) }
+			{
+			}
+
+			//true on a miss
+			bool Access(uint32_t vertex)
+			{
+				if (m_Stamps[vertex] != 0 && m_MissCount - m_Stamps[vertex] < m_CacheSize) return false;
+				m_Stamps[vertex] = ++m_MissCount;
+				return true;
+			}
+
+			uint32_t GetMissCount() const { return m_MissCount; }
+
+		private:
+			std::vector<uint32_t> m_Stamps{}; //miss count when the vertex went in, 0 is never
+			uint32_t m_CacheSize{};
+			uint32_t m_MissCount{};
+		};
+	}
+
+	float MeshOptimizer::ComputeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize)
+	{
+		if (indices.size() < 3) return 0.f;
+
+		FifoCache cache{ vertexCount, cacheSize };
+		for (const uint32_t index : indices)
+		{
+			cache.Access(index);
+		}
+		return float(cache.GetMissCount()) / float(indices.size() / 3);
+	}
+
+	void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		if (triangleCount == 0) return;
+
+		//triangles per vertex in one array, a vertex's list shrinks as its triangles get drawn
+		std::vector<uint32_t> remainingTriangles(vertexCount, 0);
+		for (size_t i{}; i < triangleCount * 3; ++i)
+		{
+			++remainingTriangles[indices[i]];
+		}
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t v{}; v < vertexCount; ++v)
+		{
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingTriangles[v];
+		}
+		std::vector<uint32_t> adjacency(adjacencyOffsets[vertexCount]);
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i{}; i < triangleCount * 3; ++i)
+			{
+				adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+			}
+		}
+
+		std::vector<int> cachePositions(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t v{}; v < vertexCount; ++v)
+		{
+			vertexScores[v] = ForsythVertexScore(-1, remainingTriangles[v]);
+		}
+
+		const auto scoreTriangle{ [&](size_t triangle)
+			{
+				return vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+			} };
+
+		//the very first pick is the best triangle of the whole mesh
+		std::vector<uint8_t> isDrawn(triangleCount, 0);
+		int64_t bestTriangle{ 0 };
+		float bestScore{ scoreTriangle(0) };
+		for (size_t t{ 1 }; t < triangleCount; ++t)
+		{
+			const float score{ scoreTriangle(t) };
+			if (score > bestScore)
+			{
+				bestScore = score;
+				bestTriangle = int64_t(t);
+			}
+		}
+
+		std::vector<uint32_t> output{};
+		output.reserve(triangleCount * 3);
+		uint32_t cache[g_ForsythCacheSize + 3]{};
+		int cacheCount{ 0 };
+		size_t nextUndrawn{ 0 };
+
+		for (size_t drawn{}; drawn < triangleCount; ++drawn)
+		{
+			//nothing in the cache has triangles left, carry on with the first one not drawn yet
+			if (bestTriangle < 0)
+			{
+				while (isDrawn[nextUndrawn]) ++nextUndrawn;
+				bestTriangle = int64_t(nextUndrawn);
+			}
+
+			const uint32_t triangle[3]{ indices[bestTriangle * 3], indices[bestTriangle * 3 + 1], indices[bestTriangle * 3 + 2] };
+			output.insert(output.end(), triangle, triangle + 3);
+			isDrawn[bestTriangle] = 1;
+
+			//take the triangle out of its vertices' lists
+			for (const uint32_t v : triangle)
+			{
+				uint32_t* pBegin{ adjacency.data() + adjacencyOffsets[v] };
+				uint32_t* pEnd{ pBegin + remainingTriangles[v] };
+				uint32_t* pFound{ std::find(pBegin, pEnd, uint32_t(bestTriangle)) };
+				if (pFound == pEnd) continue; //degenerate triangle, its vertex was already handled
+				*pFound = *(pEnd - 1);
+				--remainingTriangles[v];
+			}
+
+			//the triangle's vertices move to the front, the rest shifts back and whatever falls off the end is evicted
+			uint32_t newCache[g_ForsythCacheSize + 3]{};
+			int newCount{ 0 };
+			for (const uint32_t v : triangle)
+			{
+				if (std::find(newCache, newCache + newCount, v) == newCache + newCount) newCache[newCount++] = v;
+			}
+			for (int i{}; i < cacheCount; ++i)
+			{
+				if (std::find(triangle, triangle + 3, cache[i]) == triangle + 3) newCache[newCount++] = cache[i];
+			}
+
+			for (int i{}; i < newCount; ++i)
+			{
+				const uint32_t v{ newCache[i] };
+				cachePositions[v] = i < g_ForsythCacheSize ? i : -1;
+				vertexScores[v] = ForsythVertexScore(cachePositions[v], remainingTriangles[v]);
+			}
+
+			//only triangles touching the cache changed score, the next pick is the best of those
+			bestTriangle = -1;
+			bestScore = -1.f;
+			for (int i{}; i < newCount; ++i)
+			{
+				const uint32_t v{ newCache[i] };
+				for (uint32_t j{}; j < remainingTriangles[v]; ++j)
+				{
+					const uint32_t t{ adjacency[adjacencyOffsets[v] + j] };
+					const float score{ scoreTriangle(t) };
+					if (score > bestScore)
+					{
+						bestScore = score;
+						bestTriangle = t;
+					}
+				}
+			}
+
+			cacheCount = std::min(newCount, g_ForsythCacheSize);
+			std::copy(newCache, newCache + cacheCount, cache);
+		}
+
+		indices.swap(output);
+	}
+
+	void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, int cacheSize)
+	{
+		const size_t triangleCount{ indices.size() / 3 };
+		if (triangleCount == 0) return;
+
+		//a triangle that misses on all three corners starts over anyway, moving the clusters between those costs no extra misses
+		std::vector<size_t> clusterStarts{};
+		FifoCache cache{ vertices.size(), cacheSize };
+		for (size_t t{}; t < triangleCount; ++t)
+		{
+			int missCount{ 0 };
+			for (int corner{}; corner < 3; ++corner)
+			{
+				if (cache.Access(indices[t * 3 + corner])) ++missCount;
+			}
+			if (t == 0 || missCount == 3) clusterStarts.push_back(t);
+		}
+		clusterStarts.push_back(triangleCount);
+
+		//area weighted centroid and normal per cluster, the vertex normals don't care which way the winding goes
+		struct Cluster
+		{
+			size_t first{};
+			size_t end{};
+			Vector3 centroid{};
+			Vector3 normal{};
+			float area{};
+			float sortKey{};
+		};
+		std::vector<Cluster> clusters(clusterStarts.size() - 1);
+		Vector3 meshCentroid{};
+		float meshArea{ 0.f };
+		for (size_t c{}; c < clusters.size(); ++c)
+		{
+			Cluster& cluster{ clusters[c] };
+			cluster.first = clusterStarts[c];
+			cluster.end = clusterStarts[c + 1];
+			for (size_t t{ cluster.first }; t < cluster.end; ++t)
+			{
+				const Vertex& v0{ vertices[indices[t * 3]] };
+				const Vertex& v1{ vertices[indices[t * 3 + 1]] };
+				const Vertex& v2{ vertices[indices[t * 3 + 2]] };
+				const float area{ Vector3::Cross(v1.position - v0.position, v2.position - v0.position).Magnitude() * 0.5f };
+
+				cluster.centroid += (v0.position + v1.position + v2.position) * (area / 3.f);
+				cluster.normal += (v0.normal + v1.normal + v2.normal) * area;
+				cluster.area += area;
+			}
+			meshCentroid += cluster.centroid;
+			meshArea += cluster.area;
+			if (cluster.area > 0.f) cluster.centroid = cluster.centroid / cluster.area;
+		}
+		if (meshArea > 0.f) meshCentroid = meshCentroid / meshArea;
+
+		//how far the cluster faces away from the middle of the mesh, the most outward ones get drawn first
+		for (Cluster& cluster : clusters)
+		{
+			const float normalLength{ cluster.normal.Magnitude() };
+			cluster.sortKey = normalLength > 0.f ? Vector3::Dot(cluster.centroid - meshCentroid, cluster.normal) / normalLength : 0.f;
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<uint32_t> output{};
+		output.reserve(indices.size());
+		for (const Cluster& cluster : clusters)
+		{
+			output.insert(output.end(), indices.begin() + cluster.first * 3, indices.begin() + cluster.end * 3);
+		}
+		indices.swap(output);
+	}
+
+	void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		//vertices no triangle uses get dropped on the way
+		constexpr uint32_t unused{ ~0u };
+		std::vector<uint32_t> remap(vertices.size(), unused);
+		std::vector<Vertex> reordered{};
+		reordered.reserve(vertices.size());
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == unused)
+			{
+				remap[index] = uint32_t(reordered.size());
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		vertices.swap(reordered);
+	}
+}
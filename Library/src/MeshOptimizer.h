@@ -0,0 +1,28 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+//load time passes over an indexed triangle list, run in this order
+//OptimizeVertexCache, then OptimizeOverdraw on its clusters, then OptimizeVertexFetch for the vertex buffer
+namespace dae
+{
+	namespace MeshOptimizer
+	{
+		//average cache misses per triangle with a FIFO post-transform cache, 0.5 is the best a big grid can do, 3 is no reuse at all
+		float ComputeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, int cacheSize = 16);
+
+		//Forsyth's linear speed vertex cache optimisation, greedily picks the triangle that scores best against a simulated LRU cache
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+		//splits the cache ordered list where the cache restarts and draws the clusters that face outwards first
+		//those are the likely occluders, so the Hi-Z rejects more of what comes after them
+		void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, int cacheSize = 16);
+
+		//renumbers the vertices in the order the triangles first use them, so the vertex stage reads and the binner gathers close together
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	}
+}
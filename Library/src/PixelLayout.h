@@ -0,0 +1,125 @@
+#pragma once
+#include <cstdint>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace dae
+{
+	//maps a pixel to its offset in a buffer, so every buffer using the same layout walks memory the same way
+	//RowMajor is the usual px + py * width, Tiled stores every tile (4x4, 8x8, ...) as consecutive values
+	//both keep the pixels of a tile row next to each other, the SIMD path loads and stores 8 of those in one go
+	//Morton interleaves the x and y bits so neighbours in any direction stay close, meant for texture reads
+	class PixelLayout final
+	{
+	public:
+		enum class Type
+		{
+			RowMajor,
+			Tiled,
+			Morton
+		};
+
+		PixelLayout() = default;
+		PixelLayout(int width, int height, Type type, int tileSize = 8) :
+			m_Type{ type }
+		{
+			//tile size has to be a power of two
+			while ((1 << m_TileShift) < tileSize) ++m_TileShift;
+			m_TileMask = (1 << m_TileShift) - 1;
+
+			if (type == Type::Morton)
+			{
+				//morton needs power of two sides, the bits of the longer side that have no partner go on top
+				m_PaddedWidth = 1;
+				m_PaddedHeight = 1;
+				while (m_PaddedWidth < width) m_PaddedWidth *= 2;
+				while (m_PaddedHeight < height) m_PaddedHeight *= 2;
+				while ((2 << m_MortonBits) <= m_PaddedWidth && (2 << m_MortonBits) <= m_PaddedHeight) ++m_MortonBits;
+				m_MortonMask = (1 << m_MortonBits) - 1;
+				return;
+			}
+
+			m_PaddedWidth = (width + m_TileMask) & ~m_TileMask;
+			m_PaddedHeight = (height + m_TileMask) & ~m_TileMask;
+
+			//one formula for RowMajor and Tiled, only the pitches differ
+			const int tileSide{ 1 << m_TileShift };
+			m_TileRowPitch = m_PaddedWidth * tileSide;
+			m_RowPitch = type == Type::RowMajor ? m_PaddedWidth : tileSide;
+			m_TilePitch = type == Type::RowMajor ? tileSide : tileSide * tileSide;
+		}
+
+		int GetIndex(int px, int py) const
+		{
+			if (m_Type == Type::Morton)
+			{
+				const int interleaved{ int(SpreadBits(uint32_t(px & m_MortonMask)) | (SpreadBits(uint32_t(py & m_MortonMask)) << 1)) };
+				return interleaved + (((px >> m_MortonBits) + (py >> m_MortonBits)) << (2 * m_MortonBits));
+			}
+			return (py >> m_TileShift) * m_TileRowPitch + (py & m_TileMask) * m_RowPitch + (px >> m_TileShift) * m_TilePitch + (px & m_TileMask);
+		}
+
+#ifdef __AVX2__
+		//GetIndex for 8 pixels at once, for texture gathers
+		__m256i GetIndex8(__m256i px, __m256i py) const
+		{
+			if (m_Type == Type::Morton)
+			{
+				const __m256i mask{ _mm256_set1_epi32(m_MortonMask) };
+				const __m128i bits{ _mm_cvtsi32_si128(m_MortonBits) };
+				const __m256i interleaved{ _mm256_or_si256(SpreadBits8(_mm256_and_si256(px, mask)), _mm256_slli_epi32(SpreadBits8(_mm256_and_si256(py, mask)), 1)) };
+				const __m256i high{ _mm256_add_epi32(_mm256_srl_epi32(px, bits), _mm256_srl_epi32(py, bits)) };
+				return _mm256_add_epi32(interleaved, _mm256_sll_epi32(high, _mm_cvtsi32_si128(2 * m_MortonBits)));
+			}
+
+			const __m128i shift{ _mm_cvtsi32_si128(m_TileShift) };
+			const __m256i mask{ _mm256_set1_epi32(m_TileMask) };
+			const __m256i rows{ _mm256_add_epi32(
+				_mm256_mullo_epi32(_mm256_srl_epi32(py, shift), _mm256_set1_epi32(m_TileRowPitch)),
+				_mm256_mullo_epi32(_mm256_and_si256(py, mask), _mm256_set1_epi32(m_RowPitch))) };
+			const __m256i columns{ _mm256_add_epi32(
+				_mm256_mullo_epi32(_mm256_srl_epi32(px, shift), _mm256_set1_epi32(m_TilePitch)),
+				_mm256_and_si256(px, mask)) };
+			return _mm256_add_epi32(rows, columns);
+		}
+#endif
+
+		//padded up to whole tiles (or powers of two for morton), so a full tile row never reads outside the buffer
+		int GetSize() const { return m_PaddedWidth * m_PaddedHeight; }
+		Type GetType() const { return m_Type; }
+
+	private:
+		//0b1111 -> 0b01010101, for coordinates up to 16 bits
+		static uint32_t SpreadBits(uint32_t v)
+		{
+			v = (v | (v << 8)) & 0x00FF00FF;
+			v = (v | (v << 4)) & 0x0F0F0F0F;
+			v = (v | (v << 2)) & 0x33333333;
+			v = (v | (v << 1)) & 0x55555555;
+			return v;
+		}
+
+#ifdef __AVX2__
+		static __m256i SpreadBits8(__m256i v)
+		{
+			v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 8)), _mm256_set1_epi32(0x00FF00FF));
+			v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 4)), _mm256_set1_epi32(0x0F0F0F0F));
+			v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 2)), _mm256_set1_epi32(0x33333333));
+			v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 1)), _mm256_set1_epi32(0x55555555));
+			return v;
+		}
+#endif
+
+		Type m_Type{ Type::RowMajor };
+		int m_PaddedWidth{};
+		int m_PaddedHeight{};
+		int m_TileShift{};
+		int m_TileMask{};
+		int m_TileRowPitch{};
+		int m_RowPitch{};
+		int m_TilePitch{};
+		int m_MortonBits{};
+		int m_MortonMask{};
+	};
+}
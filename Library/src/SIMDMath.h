@@ -0,0 +1,167 @@
+#pragma once
+#ifdef __AVX2__
+#include <immintrin.h>
+#include "Matrix.h"
+#include "Vector3.h"
+
+namespace dae
+{
+	//structure of arrays version of Vector3, one vector per lane (8 pixels or 8 vertices at once)
+	struct Vector3x8
+	{
+		__m256 x{};
+		__m256 y{};
+		__m256 z{};
+
+		Vector3x8() = default;
+		Vector3x8(__m256 _x, __m256 _y, __m256 _z) : x{ _x }, y{ _y }, z{ _z } {}
+		explicit Vector3x8(const Vector3& v) : x{ _mm256_set1_ps(v.x) }, y{ _mm256_set1_ps(v.y) }, z{ _mm256_set1_ps(v.z) } {}
+
+		static __m256 Dot(const Vector3x8& v1, const Vector3x8& v2)
+		{
+			return _mm256_fmadd_ps(v1.x, v2.x, _mm256_fmadd_ps(v1.y, v2.y, _mm256_mul_ps(v1.z, v2.z)));
+		}
+
+		static Vector3x8 Cross(const Vector3x8& v1, const Vector3x8& v2)
+		{
+			return {
+				_mm256_fmsub_ps(v1.y, v2.z, _mm256_mul_ps(v1.z, v2.y)),
+				_mm256_fmsub_ps(v1.z, v2.x, _mm256_mul_ps(v1.x, v2.z)),
+				_mm256_fmsub_ps(v1.x, v2.y, _mm256_mul_ps(v1.y, v2.x)) };
+		}
+
+		static Vector3x8 Reflect(const Vector3x8& v1, const Vector3x8& v2)
+		{
+			const __m256 twoDot{ _mm256_mul_ps(_mm256_set1_ps(2.f), Dot(v1, v2)) };
+			return v1 - v2 * twoDot;
+		}
+
+		Vector3x8 Normalized() const
+		{
+			const __m256 invLength{ _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(Dot(*this, *this))) };
+			return *this * invLength;
+		}
+
+		Vector3x8 operator*(__m256 scale) const
+		{
+			return { _mm256_mul_ps(x, scale), _mm256_mul_ps(y, scale), _mm256_mul_ps(z, scale) };
+		}
+
+		Vector3x8 operator+(const Vector3x8& v) const
+		{
+			return { _mm256_add_ps(x, v.x), _mm256_add_ps(y, v.y), _mm256_add_ps(z, v.z) };
+		}
+
+		Vector3x8 operator-(const Vector3x8& v) const
+		{
+			return { _mm256_sub_ps(x, v.x), _mm256_sub_ps(y, v.y), _mm256_sub_ps(z, v.z) };
+		}
+	};
+
+	//structure of arrays version of Vector4, clip space positions of 8 vertices
+	struct Vector4x8
+	{
+		__m256 x{};
+		__m256 y{};
+		__m256 z{};
+		__m256 w{};
+	};
+
+	//one row of a matrix times 8 vectors, m0 * v.x + m1 * v.y + m2 * v.z + offset
+	inline __m256 TransformComponent8(float m0, float m1, float m2, const Vector3x8& v, __m256 offset)
+	{
+		return _mm256_fmadd_ps(_mm256_set1_ps(m0), v.x, _mm256_fmadd_ps(_mm256_set1_ps(m1), v.y, _mm256_fmadd_ps(_mm256_set1_ps(m2), v.z, offset)));
+	}
+
+	//Matrix::TransformVector for 8 vectors, no translation
+	inline Vector3x8 TransformVector8(const Matrix& m, const Vector3x8& v)
+	{
+		const Vector4 r0{ m[0] }, r1{ m[1] }, r2{ m[2] };
+		const __m256 zero{ _mm256_setzero_ps() };
+		return { TransformComponent8(r0.x, r1.x, r2.x, v, zero), TransformComponent8(r0.y, r1.y, r2.y, v, zero), TransformComponent8(r0.z, r1.z, r2.z, v, zero) };
+	}
+
+	//Matrix::TransformPoint(Vector3) for 8 points, affine so w is left out
+	inline Vector3x8 TransformPoint8(const Matrix& m, const Vector3x8& p)
+	{
+		const Vector4 r0{ m[0] }, r1{ m[1] }, r2{ m[2] }, r3{ m[3] };
+		return {
+			TransformComponent8(r0.x, r1.x, r2.x, p, _mm256_set1_ps(r3.x)),
+			TransformComponent8(r0.y, r1.y, r2.y, p, _mm256_set1_ps(r3.y)),
+			TransformComponent8(r0.z, r1.z, r2.z, p, _mm256_set1_ps(r3.z)) };
+	}
+
+	//Matrix::TransformPoint(Vector4{ p, 1 }) for 8 points, w comes out of the matrix for projections
+	inline Vector4x8 ProjectPoint8(const Matrix& m, const Vector3x8& p)
+	{
+		const Vector3x8 xyz{ TransformPoint8(m, p) };
+		const Vector4 r0{ m[0] }, r1{ m[1] }, r2{ m[2] }, r3{ m[3] };
+		return { xyz.x, xyz.y, xyz.z, TransformComponent8(r0.w, r1.w, r2.w, p, _mm256_set1_ps(r3.w)) };
+	}
+
+	//barycentric style blend of three per-triangle constants, w0 * a + w1 * b + w2 * c
+	inline __m256 Lico8(__m256 w0, float a, __m256 w1, float b, __m256 w2, float c)
+	{
+		return _mm256_fmadd_ps(w0, _mm256_set1_ps(a), _mm256_fmadd_ps(w1, _mm256_set1_ps(b), _mm256_mul_ps(w2, _mm256_set1_ps(c))));
+	}
+
+	inline Vector3x8 Lico8(__m256 w0, const Vector3& a, __m256 w1, const Vector3& b, __m256 w2, const Vector3& c)
+	{
+		return { Lico8(w0, a.x, w1, b.x, w2, c.x), Lico8(w0, a.y, w1, b.y, w2, c.y), Lico8(w0, a.z, w1, b.z, w2, c.z) };
+	}
+
+	//log2 for positive inputs, exponent from the float bits and a polynomial for the mantissa in [1, 2)
+	inline __m256 Log2x8(__m256 v)
+	{
+		const __m256i bits{ _mm256_castps_si256(v) };
+		const __m256 exponent{ _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127))) };
+		const __m256 mantissa{ _mm256_or_ps(_mm256_castsi256_ps(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF))), _mm256_set1_ps(1.f)) };
+
+		//5th order fit of log2(m) / (m - 1), max error around 1e-5
+		__m256 p{ _mm256_set1_ps(-0.0344359067839062357313f) };
+		p = _mm256_fmadd_ps(p, mantissa, _mm256_set1_ps(0.318212422185251071475f));
+		p = _mm256_fmadd_ps(p, mantissa, _mm256_set1_ps(-1.23152682416275988241f));
+		p = _mm256_fmadd_ps(p, mantissa, _mm256_set1_ps(2.59883907202499966007f));
+		p = _mm256_fmadd_ps(p, mantissa, _mm256_set1_ps(-3.32419399085241980044f));
+		p = _mm256_fmadd_ps(p, mantissa, _mm256_set1_ps(3.11578814719469302614f));
+
+		return _mm256_fmadd_ps(p, _mm256_sub_ps(mantissa, _mm256_set1_ps(1.f)), exponent);
+	}
+
+	//2^v, integer part goes straight into the exponent bits, polynomial for the fraction
+	inline __m256 Exp2x8(__m256 v)
+	{
+		v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-126.f)), _mm256_set1_ps(126.f));
+
+		const __m256 whole{ _mm256_floor_ps(v) };
+		const __m256 fraction{ _mm256_sub_ps(v, whole) };
+
+		//5th order fit of 2^f for f in [0, 1)
+		__m256 p{ _mm256_set1_ps(1.8775767e-3f) };
+		p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(8.9893397e-3f));
+		p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(5.5826318e-2f));
+		p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(2.4015361e-1f));
+		p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(6.9315308e-1f));
+		p = _mm256_fmadd_ps(p, fraction, _mm256_set1_ps(9.9999994e-1f));
+
+		const __m256i exponent{ _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23) };
+		return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+	}
+
+	//powf for a base in [0, 1] and a non negative exponent, pow(0, 0) stays 1 like powf
+	inline __m256 Pow8(__m256 base, __m256 exponent)
+	{
+		const __m256 safeBase{ _mm256_max_ps(base, _mm256_set1_ps(1e-30f)) };
+		return Exp2x8(_mm256_mul_ps(exponent, Log2x8(safeBase)));
+	}
+
+	//smallest of the 8 lanes
+	inline float HorizontalMin(__m256 v)
+	{
+		__m128 m{ _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)) };
+		m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+		m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+		return _mm_cvtss_f32(m);
+	}
+}
+#endif
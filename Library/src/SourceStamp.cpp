@@ -0,0 +1,69 @@
+#include "SourceStamp.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <filesystem>
+
+namespace dae
+{
+	namespace
+	{
+		//size and write time, false when the file isn't there
+		bool ReadFileStamp(const std::string& path, SourceStamp& stamp)
+		{
+			std::error_code error{};
+			stamp.size = std::filesystem::file_size(path, error);
+			if (error) return false;
+			const auto writeTime{ std::filesystem::last_write_time(path, error) };
+			if (error) return false;
+			stamp.writeTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+			return true;
+		}
+
+		//four multiply-xor lanes over 8 byte words so the multiplies overlap, then the lanes and the tail get folded in
+		uint64_t HashBytes(const char* pData, size_t size)
+		{
+			constexpr uint64_t prime{ 0x9E3779B97F4A7C15ull };
+			uint64_t lanes[4]{ 1, 2, 3, 4 };
+			size_t i{};
+			for (; i + 32 <= size; i += 32)
+			{
+				for (int lane{}; lane < 4; ++lane)
+				{
+					uint64_t word{};
+					std::memcpy(&word, pData + i + lane * 8, sizeof(word));
+					lanes[lane] = (lanes[lane] ^ word) * prime;
+					lanes[lane] ^= lanes[lane] >> 32;
+				}
+			}
+
+			uint64_t hash{ size };
+			for (const uint64_t lane : lanes) hash = (hash ^ lane) * prime;
+			for (; i < size; ++i) hash = (hash ^ uint8_t(pData[i])) * prime;
+			return hash ^ (hash >> 29);
+		}
+
+		uint64_t HashFile(const std::string& path)
+		{
+			const MappedFile file{ path };
+			return file.IsOpen() ? HashBytes(file.GetData(), file.GetSize()) : 0;
+		}
+	}
+
+	SourceStamp MakeSourceStamp(const std::string& path)
+	{
+		SourceStamp stamp{};
+		if (!ReadFileStamp(path, stamp)) return SourceStamp{};
+		stamp.hash = HashFile(path);
+		return stamp;
+	}
+
+	bool MatchesSourceStamp(const std::string& path, const SourceStamp& stamp)
+	{
+		SourceStamp current{};
+		if (!ReadFileStamp(path, current)) return true;
+		if (current.size != stamp.size) return false;
+
+		//a source that was only touched or copied still matches on its contents
+		return current.writeTime == stamp.writeTime || HashFile(path) == stamp.hash;
+	}
+}
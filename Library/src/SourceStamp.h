@@ -0,0 +1,23 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	//what a cache file remembers of a source it was built from, stored in the cache header as is
+	struct SourceStamp
+	{
+		uint64_t size{};
+		int64_t writeTime{};
+		uint64_t hash{}; //of the contents, not cryptographic, just enough to notice an edit
+	};
+
+	//stamp of path with its contents hashed, all zeros when it can't be read
+	SourceStamp MakeSourceStamp(const std::string& path);
+
+	//false only when path exists and is not the file the stamp was taken of, a missing source leaves the cache alone
+	//size and write time are compared first, the contents only get hashed when the write time moved
+	bool MatchesSourceStamp(const std::string& path, const SourceStamp& stamp);
+}
@@ -1,27 +1,245 @@
 #include "Texture.h"
-#include "Vector2.h"
+#include "MappedFile.h"
+#include "SourceStamp.h"
 #include <SDL_image.h>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 namespace dae
 {
-	Texture::Texture(SDL_Surface* pSurface) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels }
+	//the chain exactly as m_pPixels holds it follows the header, the level layouts are rebuilt from the size, layout and tile size
+	struct Texture::ContainerHeader
 	{
+		static constexpr uint32_t Version{ 1 };
+		static constexpr int MaxSources{ 2 };
+
+		char magic[8]{};
+		uint32_t version{};
+		uint32_t layoutType{};
+		int32_t tileSize{};
+		int32_t width{};
+		int32_t height{};
+		uint32_t sourceCount{};
+		SourceStamp sources[MaxSources]{};
+		uint64_t pixelOffset{}; //from the start of the file, aligned like m_pPixels
+		uint64_t pixelCount{};
+	};
+
+	namespace
+	{
+		constexpr char g_ContainerMagic[8]{ 'D', 'A', 'E', 'T', 'E', 'X', '\0', '\0' };
+	}
+
+	Texture::Texture(int width, int height, PixelLayout::Type layout, int tileSize)
+	{
+		m_LevelCount = 0;
+		for (int levelWidth{ width }, levelHeight{ height }; m_LevelCount < m_MaxLevels; levelWidth = std::max(levelWidth / 2, 1), levelHeight = std::max(levelHeight / 2, 1))
+		{
+			MipLevel& level{ m_Levels[m_LevelCount++] };
+			level.width = levelWidth;
+			level.height = levelHeight;
+			level.layout = PixelLayout{ levelWidth, levelHeight, layout, tileSize };
+			m_ChainSize += level.layout.GetSize();
+			if (levelWidth == 1 && levelHeight == 1) break;
+		}
+
+		m_LodOffset = 0.5f * std::log2(float(width) * float(height));
+	}
+
+	Texture::Texture(int width, int height, const uint8_t* pRowMajorPixels, int pitch, PixelLayout::Type layout, int tileSize) :
+		Texture{ width, height, layout, tileSize }
+	{
+		//one allocation for the whole chain
+		m_pPixels = static_cast<uint32_t*>(::operator new[](sizeof(uint32_t) * m_ChainSize, m_Alignment));
+		//the tiles pad some levels past their texels, nothing else writes there and the container is saved as is
+		std::memset(m_pPixels, 0, sizeof(uint32_t) * m_ChainSize);
+		uint32_t* pLevelPixels{ m_pPixels };
+		for (int i{}; i < m_LevelCount; ++i)
+		{
+			m_Levels[i].pPixels = pLevelPixels;
+			pLevelPixels += m_Levels[i].layout.GetSize();
+		}
+
+		//the surface rows can be padded, every texel goes to wherever the layout wants it
+		uint32_t* pBase{ m_pPixels };
+		for (int y{}; y < height; ++y)
+		{
+			const uint32_t* pRow{ reinterpret_cast<const uint32_t*>(pRowMajorPixels + y * pitch) };
+			for (int x{}; x < width; ++x)
+			{
+				pBase[m_Levels[0].layout.GetIndex(x, y)] = pRow[x];
+			}
+		}
+
+		GenerateMipChain();
 	}
 
 	Texture::~Texture()
 	{
-		if (m_pSurface)
+		::operator delete[](m_pPixels, m_Alignment);
+		delete m_pContainer;
+	}
+
+	Texture* Texture::LoadFromFile(const std::string& path, PixelLayout::Type layout, int tileSize)
+	{
+		const std::vector<std::string> sourcePaths{ path };
+		const std::string containerPath{ GetContainerPath(sourcePaths, layout, tileSize) };
+		if (Texture* pTexture{ LoadContainer(containerPath, sourcePaths, layout, tileSize) }) return pTexture;
+
+		SDL_Surface* pSurface{ LoadSurfaceRGBA8(path) };
+		if (pSurface == nullptr) return nullptr;
+
+		Texture* pTexture{ new Texture{ pSurface->w, pSurface->h, static_cast<const uint8_t*>(pSurface->pixels), pSurface->pitch, layout, tileSize } };
+		SDL_FreeSurface(pSurface);
+		pTexture->WriteContainer(containerPath, sourcePaths, layout, tileSize);
+		return pTexture;
+	}
+
+	Texture* Texture::LoadPacked(const std::string& colorPath, const std::string& alphaPath, PixelLayout::Type layout, int tileSize)
+	{
+		const std::vector<std::string> sourcePaths{ colorPath, alphaPath };
+		const std::string containerPath{ GetContainerPath(sourcePaths, layout, tileSize) };
+		if (Texture* pTexture{ LoadContainer(containerPath, sourcePaths, layout, tileSize) }) return pTexture;
+
+		SDL_Surface* pColor{ LoadSurfaceRGBA8(colorPath) };
+		SDL_Surface* pAlpha{ LoadSurfaceRGBA8(alphaPath) };
+		if (pColor == nullptr || pAlpha == nullptr || pColor->w != pAlpha->w || pColor->h != pAlpha->h)
+		{
+			if (pColor != nullptr && pAlpha != nullptr)
+			{
+				std::cout << "Images could not be packed in Texture.cpp ->LoadPacked, sizes differ: " << colorPath.c_str() << " " << alphaPath.c_str() << std::endl;
+			}
+			SDL_FreeSurface(pColor);
+			SDL_FreeSurface(pAlpha);
+			return nullptr;
+		}
+
+		//red of the second map replaces the alpha byte of the first
+		for (int y{}; y < pColor->h; ++y)
+		{
+			uint32_t* pColorRow{ reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pColor->pixels) + y * pColor->pitch) };
+			const uint32_t* pAlphaRow{ reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(pAlpha->pixels) + y * pAlpha->pitch) };
+			for (int x{}; x < pColor->w; ++x)
+			{
+				pColorRow[x] = (pColorRow[x] & 0x00FFFFFF) | ((pAlphaRow[x] & 0xFF) << 24);
+			}
+		}
+		SDL_FreeSurface(pAlpha);
+
+		Texture* pTexture{ new Texture{ pColor->w, pColor->h, static_cast<const uint8_t*>(pColor->pixels), pColor->pitch, layout, tileSize } };
+		SDL_FreeSurface(pColor);
+		pTexture->WriteContainer(containerPath, sourcePaths, layout, tileSize);
+		return pTexture;
+	}
+
+	Texture* Texture::CreateSolid(uint32_t texel, PixelLayout::Type layout, int tileSize)
+	{
+		return new Texture{ 1, 1, reinterpret_cast<const uint8_t*>(&texel), sizeof(texel), layout, tileSize };
+	}
+
+	std::string Texture::GetContainerPath(const std::vector<std::string>& sourcePaths, PixelLayout::Type layout, int tileSize)
+	{
+		//next to the first image, every image and the layout in the name, e.g. vehicle_diffuse+vehicle_specular.tiled4.tex
+		const std::filesystem::path firstPath{ sourcePaths.front() };
+		std::string name{ firstPath.stem().string() };
+		for (size_t i{ 1 }; i < sourcePaths.size(); ++i)
+		{
+			name += "+" + std::filesystem::path{ sourcePaths[i] }.stem().string();
+		}
+
+		const char* layoutNames[]{ "rowmajor", "tiled", "morton" };
+		name += std::string{ "." } + layoutNames[static_cast<int>(layout)] + std::to_string(tileSize) + ".tex";
+		return (firstPath.parent_path() / name).string();
+	}
+
+	Texture* Texture::LoadContainer(const std::string& path, const std::vector<std::string>& sourcePaths, PixelLayout::Type layout, int tileSize)
+	{
+		//samples jump around the chain, so no read ahead, only the pages that get sampled are loaded
+		MappedFile* pFile{ new MappedFile{ path, MappedFile::Access::Random } };
+		const ContainerHeader* pHeader{ reinterpret_cast<const ContainerHeader*>(pFile->GetData()) };
+		const bool isCurrent{ pFile->GetSize() >= sizeof(ContainerHeader)
+			&& std::memcmp(pHeader->magic, g_ContainerMagic, sizeof(g_ContainerMagic)) == 0
+			&& pHeader->version == ContainerHeader::Version
+			&& pHeader->layoutType == static_cast<uint32_t>(layout) && pHeader->tileSize == tileSize
+			&& pHeader->width > 0 && pHeader->height > 0
+			&& pHeader->sourceCount <= ContainerHeader::MaxSources && pHeader->sourceCount == sourcePaths.size() };
+
+		bool sourcesMatch{ isCurrent };
+		for (size_t i{}; sourcesMatch && i < sourcePaths.size(); ++i)
+		{
+			sourcesMatch = MatchesSourceStamp(sourcePaths[i], pHeader->sources[i]);
+		}
+		if (!sourcesMatch)
+		{
+			delete pFile;
+			return nullptr;
+		}
+
+		//the chain has to be the size these levels need and fit in the file
+		Texture* pTexture{ new Texture{ pHeader->width, pHeader->height, layout, tileSize } };
+		if (pHeader->pixelCount != pTexture->m_ChainSize || pHeader->pixelOffset % static_cast<uint64_t>(m_Alignment) != 0
+			|| pHeader->pixelOffset + pHeader->pixelCount * sizeof(uint32_t) > pFile->GetSize())
+		{
+			delete pTexture;
+			delete pFile;
+			return nullptr;
+		}
+
+		pTexture->m_pContainer = pFile;
+		const uint32_t* pLevelPixels{ reinterpret_cast<const uint32_t*>(pFile->GetData() + pHeader->pixelOffset) };
+		for (int i{}; i < pTexture->m_LevelCount; ++i)
+		{
+			pTexture->m_Levels[i].pPixels = pLevelPixels;
+			pLevelPixels += pTexture->m_Levels[i].layout.GetSize();
+		}
+
+		std::cout << "Image: " << path.c_str() << " mapped" << std::endl;
+		return pTexture;
+	}
+
+	void Texture::WriteContainer(const std::string& path, const std::vector<std::string>& sourcePaths, PixelLayout::Type layout, int tileSize) const
+	{
+		ContainerHeader header{};
+		std::memcpy(header.magic, g_ContainerMagic, sizeof(g_ContainerMagic));
+		header.version = ContainerHeader::Version;
+		header.layoutType = static_cast<uint32_t>(layout);
+		header.tileSize = tileSize;
+		header.width = m_Levels[0].width;
+		header.height = m_Levels[0].height;
+		header.sourceCount = static_cast<uint32_t>(std::min(sourcePaths.size(), size_t(ContainerHeader::MaxSources)));
+		for (uint32_t i{}; i < header.sourceCount; ++i)
+		{
+			header.sources[i] = MakeSourceStamp(sourcePaths[i]);
+		}
+		const uint64_t alignment{ static_cast<uint64_t>(m_Alignment) };
+		header.pixelOffset = (sizeof(ContainerHeader) + alignment - 1) / alignment * alignment;
+		header.pixelCount = m_ChainSize;
+
+		//written next to it and renamed over, a half written container is never mapped
+		const std::string tempPath{ path + ".tmp" };
+		bool isWritten{ false };
+		{
+			std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+			const char padding[static_cast<size_t>(m_Alignment)]{};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(ContainerHeader));
+			file.write(padding, header.pixelOffset - sizeof(ContainerHeader));
+			file.write(reinterpret_cast<const char*>(m_pPixels), m_ChainSize * sizeof(uint32_t));
+			isWritten = static_cast<bool>(file);
+		}
+
+		std::error_code error{};
+		if (isWritten) std::filesystem::rename(tempPath, path, error);
+		if (!isWritten || error)
 		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
+			std::filesystem::remove(tempPath, error);
+			std::cout << "Texture container could not be written in Texture.cpp ->WriteContainer: " << path.c_str() << std::endl;
 		}
 	}
 
-	Texture* Texture::LoadFromFile(const std::string& path)
+	SDL_Surface* Texture::LoadSurfaceRGBA8(const std::string& path)
 	{
-		//TODO
 		//Load SDL_Surface using IMG_LOAD
 		SDL_Surface* surfaceBuffer{ IMG_Load(path.c_str())};
 
@@ -34,71 +252,140 @@ namespace dae
 		{
 			std::cout << "Image: " << path.c_str() << "successfully loaded" << std::endl;
 		}
-		//m_pSurfacePixels = (uint32_t*)surfaceBuffer->pixels;
-		//Texture* outputTexture = new Texture{ surfaceBuffer }; //integrated in the return
-
-		//Create & Return a new Texture Object (using SDL_Surface)
-		return new Texture{ surfaceBuffer };
 
-		
-		//here for debugging, should never be hit
-		return nullptr;
+		//whatever the file was, convert it once to RGBA8 so sampling never needs the surface format
+		SDL_Surface* pConverted{ SDL_ConvertSurfaceFormat(surfaceBuffer, SDL_PIXELFORMAT_RGBA32, 0) };
+		SDL_FreeSurface(surfaceBuffer);
+		if (pConverted == nullptr)
+		{
+			std::cout << "Image could not be converted in Texture.cpp ->LoadFromFIle: " << path.c_str() << std::endl;
+		}
+		return pConverted;
 	}
 
-	ColorRGB Texture::Sample(const Vector2& uv) const
+	void Texture::GenerateMipChain()
 	{
-		//TODO
-		//Sample the correct texel for the given uv
-		const int width{ m_pSurface->w };
-		const int height{ m_pSurface->h };
-		const float aspecRatio{ static_cast<float>(width) / static_cast<float>(height) };
-
-		const int scaledU{ static_cast<int>(uv.x * width) };
-		const int scaledV{ static_cast<int>(uv.y * height) };
-
-		uint32_t m_pSurfacePixel = m_pSurfacePixels[scaledU + (scaledV * width)];
-		
-		//somehow didnt work when initialising as Uint8* r{}, g{}, b{};
-		Uint8* r{ new Uint8{} };
-		Uint8* g{ new Uint8{} };
-		Uint8* b{ new Uint8{} };
-
-
-		SDL_GetRGB(m_pSurfacePixel, m_pSurface->format, r, g, b);
+		//2x2 box filter per channel, odd sizes reuse the last row or column
+		for (int i{ 1 }; i < m_LevelCount; ++i)
+		{
+			const MipLevel& source{ m_Levels[i - 1] };
+			const MipLevel& level{ m_Levels[i] };
+			uint32_t* pPixels{ const_cast<uint32_t*>(level.pPixels) };
 
-		//for reference
-		//m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-		//	static_cast<uint8_t>(finalColor.r * 255),
-		//	static_cast<uint8_t>(finalColor.g * 255),
-		//	static_cast<uint8_t>(finalColor.b * 255));
+			for (int y{}; y < level.height; ++y)
+			{
+				const int y0{ std::min(y * 2, source.height - 1) };
+				const int y1{ std::min(y * 2 + 1, source.height - 1) };
+				for (int x{}; x < level.width; ++x)
+				{
+					const int x0{ std::min(x * 2, source.width - 1) };
+					const int x1{ std::min(x * 2 + 1, source.width - 1) };
+					const uint32_t texels[4]{
+						source.pPixels[source.layout.GetIndex(x0, y0)], source.pPixels[source.layout.GetIndex(x1, y0)],
+						source.pPixels[source.layout.GetIndex(x0, y1)], source.pPixels[source.layout.GetIndex(x1, y1)] };
 
+					uint32_t filtered{ 0 };
+					for (int shift{}; shift < 32; shift += 8)
+					{
+						uint32_t sum{ 2 }; //rounds to nearest
+						for (const uint32_t texel : texels) sum += (texel >> shift) & 0xFF;
+						filtered |= (sum / 4) << shift;
+					}
+					pPixels[level.layout.GetIndex(x, y)] = filtered;
+				}
+			}
+		}
+	}
 
+	void Texture::SelectLevels(float uvLod, Filter filter, int& level0, int& level1, float& blend) const
+	{
+		const float lod{ std::clamp(uvLod + m_LodOffset, 0.f, float(m_LevelCount - 1)) };
+		if (filter == Filter::Trilinear)
+		{
+			level0 = static_cast<int>(lod);
+			level1 = std::min(level0 + 1, m_LevelCount - 1);
+			blend = lod - float(level0);
+		}
+		else
+		{
+			//nearest level
+			level0 = static_cast<int>(lod + 0.5f);
+			level1 = level0;
+			blend = 0.f;
+		}
+	}
 
-		ColorRGB outputColor{};
+	Texture::Texel Texture::SampleTexel(const Vector2& uv, float uvLod, Filter filter) const
+	{
+		int level0{}, level1{};
+		float blend{};
+		SelectLevels(uvLod, filter, level0, level1, blend);
 
-		if (r && g && b)
+		switch (filter)
 		{
+		case Filter::Point:
+			return UnpackTexelRGBA(m_Levels[level0].pPixels[GetTexelIndex(m_Levels[level0], uv)]);
+		case Filter::Bilinear:
+			return SampleBilinear(m_Levels[level0], uv);
+		case Filter::Trilinear:
+		default:
+			return Texel::Lerp(SampleBilinear(m_Levels[level0], uv), SampleBilinear(m_Levels[level1], uv), blend);
+		}
+	}
 
-			outputColor = { //has to reverse?
-				//normal
-				static_cast<float>(*r) / 255.f,
-				static_cast<float>(*g) / 255.f,
-				static_cast<float>(*b) / 255.f,
+	int Texture::GetFootprint(const Vector2& uv, float uvLod, Filter filter, const uint32_t* texels[8]) const
+	{
+		int level0{}, level1{};
+		float blend{};
+		SelectLevels(uvLod, filter, level0, level1, blend);
 
-				////reversed
-				//static_cast<float>(*b) / 255.f,
-				//static_cast<float>(*g) / 255.f,
-				//static_cast<float>(*r) / 255.f,
+		if (filter == Filter::Point)
+		{
+			texels[0] = m_Levels[level0].pPixels + GetTexelIndex(m_Levels[level0], uv);
+			return 1;
+		}
 
-			};
-		};
+		int count{ 0 };
+		const int levels[2]{ level0, level1 };
+		for (int i{}; i < (filter == Filter::Trilinear ? 2 : 1); ++i)
+		{
+			int indices[4]{};
+			float fractionX{}, fractionY{};
+			GetBilinearTexels(m_Levels[levels[i]], uv, indices, fractionX, fractionY);
+			for (const int index : indices) texels[count++] = m_Levels[levels[i]].pPixels + index;
+		}
+		return count;
+	}
 
+	Texture::Texel Texture::SampleBilinear(const MipLevel& level, const Vector2& uv) const
+	{
+		int indices[4]{};
+		float fractionX{}, fractionY{};
+		GetBilinearTexels(level, uv, indices, fractionX, fractionY);
 
+		const Texel top{ Texel::Lerp(UnpackTexelRGBA(level.pPixels[indices[0]]), UnpackTexelRGBA(level.pPixels[indices[1]]), fractionX) };
+		const Texel bottom{ Texel::Lerp(UnpackTexelRGBA(level.pPixels[indices[2]]), UnpackTexelRGBA(level.pPixels[indices[3]]), fractionX) };
+		return Texel::Lerp(top, bottom, fractionY);
+	}
 
+	void Texture::GetBilinearTexels(const MipLevel& level, const Vector2& uv, int indices[4], float& fractionX, float& fractionY)
+	{
+		//texel centers sit on half coordinates
+		const float x{ uv.x * level.width - 0.5f };
+		const float y{ uv.y * level.height - 0.5f };
+		const float floorX{ std::floor(x) };
+		const float floorY{ std::floor(y) };
+		fractionX = x - floorX;
+		fractionY = y - floorY;
 
-		return outputColor;
+		const int x0{ std::clamp(static_cast<int>(floorX), 0, level.width - 1) };
+		const int y0{ std::clamp(static_cast<int>(floorY), 0, level.height - 1) };
+		const int x1{ std::clamp(static_cast<int>(floorX) + 1, 0, level.width - 1) };
+		const int y1{ std::clamp(static_cast<int>(floorY) + 1, 0, level.height - 1) };
 
-		//debug reason, should never hit
-		return ColorRGB{ 0, 0, 0, };
+		indices[0] = level.layout.GetIndex(x0, y0);
+		indices[1] = level.layout.GetIndex(x1, y0);
+		indices[2] = level.layout.GetIndex(x0, y1);
+		indices[3] = level.layout.GetIndex(x1, y1);
 	}
 }
\ No newline at end of file
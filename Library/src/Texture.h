@@ -1,24 +1,132 @@
 #pragma once
 #include <SDL_surface.h>
+#include <algorithm>
+#include <new>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
+#include "PixelLayout.h"
+#include "Vector2.h"
 
 namespace dae
 {
-	struct Vector2;
+	class MappedFile;
 
 	class Texture
 	{
 	public:
 		~Texture();
 
-		static Texture* LoadFromFile(const std::string& path);
-		ColorRGB Sample(const Vector2& uv) const;
+		Texture(const Texture&) = delete;
+		Texture(Texture&&) noexcept = delete;
+		Texture& operator=(const Texture&) = delete;
+		Texture& operator=(Texture&&) noexcept = delete;
+
+		//every mip level is stored in the given layout, tiled 4x4 keeps a bilinear footprint in one or two cache lines
+		static Texture* LoadFromFile(const std::string& path, PixelLayout::Type layout = PixelLayout::Type::Tiled, int tileSize = 4);
+		//material packing, the red channel of alphaPath goes into the alpha of colorPath
+		//a grayscale map rides along with a color map, one fetch returns both
+		static Texture* LoadPacked(const std::string& colorPath, const std::string& alphaPath, PixelLayout::Type layout = PixelLayout::Type::Tiled, int tileSize = 4);
+		//both keep a container next to the images with the whole mip chain already in the sampler's layout (GetContainerPath)
+		//once it is there and the images haven't changed it is memory mapped as is, so no PNG gets decoded at startup
+		//and levels the sampler never reads are never paged in
+		static std::string GetContainerPath(const std::vector<std::string>& sourcePaths, PixelLayout::Type layout, int tileSize);
+		//one texel, RGBA8 like the rest, e.g. a placeholder while the real texture loads
+		static Texture* CreateSolid(uint32_t texel, PixelLayout::Type layout = PixelLayout::Type::Tiled, int tileSize = 4);
+
+		enum class Filter
+		{
+			Point,
+			Bilinear,
+			Trilinear
+		};
+
+		struct MipLevel
+		{
+			const uint32_t* pPixels{}; //RGBA8, red in the lowest byte
+			int width{};
+			int height{};
+			PixelLayout layout{};
+		};
+
+		//no allocations and no format lookups, the texels are already RGBA8. Always the full size level
+		ColorRGB Sample(const Vector2& uv) const
+		{
+			return UnpackTexel(m_Levels[0].pPixels[GetTexelIndex(m_Levels[0], uv)]);
+		}
+
+		struct Texel
+		{
+			ColorRGB color{};
+			float alpha{};
+
+			static Texel Lerp(const Texel& t1, const Texel& t2, float factor)
+			{
+				return { ColorRGB::Lerp(t1.color, t2.color, factor), Lerpf(t1.alpha, t2.alpha, factor) };
+			}
+		};
+
+		//uvLod is log2 of how many uv units one pixel covers, the texture size gets added here
+		Texel SampleTexel(const Vector2& uv, float uvLod, Filter filter) const;
+		ColorRGB Sample(const Vector2& uv, float uvLod, Filter filter) const { return SampleTexel(uv, uvLod, filter).color; }
+
+		//which levels a lod lands on, level1 and blend are only used by trilinear
+		void SelectLevels(float uvLod, Filter filter, int& level0, int& level1, float& blend) const;
+
+		//addresses of every texel a sample reads, up to 8 for trilinear. Only used to measure cache behaviour
+		int GetFootprint(const Vector2& uv, float uvLod, Filter filter, const uint32_t* texels[8]) const;
+
+		//uv outside [0, 1] clamps to the border texel
+		static int GetTexelIndex(const MipLevel& level, const Vector2& uv)
+		{
+			const int scaledU{ std::clamp(static_cast<int>(uv.x * level.width), 0, level.width - 1) };
+			const int scaledV{ std::clamp(static_cast<int>(uv.y * level.height), 0, level.height - 1) };
+			return level.layout.GetIndex(scaledU, scaledV);
+		}
+
+		static ColorRGB UnpackTexel(uint32_t texel)
+		{
+			return {
+				static_cast<float>(texel & 0xFF) * m_InvMaxChannel,
+				static_cast<float>((texel >> 8) & 0xFF) * m_InvMaxChannel,
+				static_cast<float>((texel >> 16) & 0xFF) * m_InvMaxChannel };
+		}
+
+		static Texel UnpackTexelRGBA(uint32_t texel)
+		{
+			return { UnpackTexel(texel), static_cast<float>(texel >> 24) * m_InvMaxChannel };
+		}
+
+		const MipLevel& GetLevel(int level) const { return m_Levels[level]; }
+		int GetLevelCount() const { return m_LevelCount; }
 
 	private:
-		Texture(SDL_Surface* pSurface);
+		struct ContainerHeader;
+
+		Texture(int width, int height, PixelLayout::Type layout, int tileSize); //levels laid out, no pixels yet
+		Texture(int width, int height, const uint8_t* pRowMajorPixels, int pitch, PixelLayout::Type layout, int tileSize);
+
+		//nullptr if there is no container or it is stale, the caller then decodes and writes a new one
+		static Texture* LoadContainer(const std::string& path, const std::vector<std::string>& sourcePaths, PixelLayout::Type layout, int tileSize);
+		void WriteContainer(const std::string& path, const std::vector<std::string>& sourcePaths, PixelLayout::Type layout, int tileSize) const;
+
+		static SDL_Surface* LoadSurfaceRGBA8(const std::string& path); //nullptr if loading or converting failed
+
+		void GenerateMipChain();
+		Texel SampleBilinear(const MipLevel& level, const Vector2& uv) const;
+
+		//the 2x2 texels around uv, top left, top right, bottom left, bottom right
+		static void GetBilinearTexels(const MipLevel& level, const Vector2& uv, int indices[4], float& fractionX, float& fractionY);
+
+		static constexpr float m_InvMaxChannel{ 1.f / 255.f };
+		static constexpr std::align_val_t m_Alignment{ 64 };
+		static constexpr int m_MaxLevels{ 16 };
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		uint32_t* m_pPixels{ nullptr }; //every level back to back, largest first, padded to its layout
+		MappedFile* m_pContainer{ nullptr }; //the levels point in here instead when the texture came from a container
+		size_t m_ChainSize{}; //texels over all levels
+		MipLevel m_Levels[m_MaxLevels]{};
+		int m_LevelCount{};
+		float m_LodOffset{}; //log2 of the texel count along one side of level 0
 	};
 }
\ No newline at end of file
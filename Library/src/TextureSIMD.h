@@ -0,0 +1,88 @@
+#pragma once
+#ifdef __AVX2__
+#include "SIMDMath.h"
+#include "Texture.h"
+
+namespace dae
+{
+	//Texture::Texel for 8 lanes, color in xyz plus the packed alpha
+	struct Texel8
+	{
+		Vector3x8 color{};
+		__m256 alpha{};
+
+		static Texel8 Lerp(const Texel8& t1, const Texel8& t2, __m256 factor)
+		{
+			return { t1.color + (t2.color - t1.color) * factor, _mm256_fmadd_ps(_mm256_sub_ps(t2.alpha, t1.alpha), factor, t1.alpha) };
+		}
+	};
+
+	//RGBA8, red in the lowest byte
+	inline Texel8 UnpackTexels8(__m256i texels)
+	{
+		const __m256i channelMask{ _mm256_set1_epi32(0xFF) };
+		const __m256 invMaxChannel{ _mm256_set1_ps(1.f / 255.f) };
+		return {
+			{
+				_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(texels, channelMask)), invMaxChannel),
+				_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texels, 8), channelMask)), invMaxChannel),
+				_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texels, 16), channelMask)), invMaxChannel) },
+			_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(texels, 24)), invMaxChannel) };
+	}
+
+	//x and y get clamped to the level, dead lanes don't load anything
+	inline Texel8 FetchTexels8(const Texture::MipLevel& level, __m256i x, __m256i y, __m256i activeLanes)
+	{
+		const __m256i zero{ _mm256_setzero_si256() };
+		x = _mm256_min_epi32(_mm256_max_epi32(x, zero), _mm256_set1_epi32(level.width - 1));
+		y = _mm256_min_epi32(_mm256_max_epi32(y, zero), _mm256_set1_epi32(level.height - 1));
+		const __m256i texelIndex{ level.layout.GetIndex8(x, y) };
+		return UnpackTexels8(_mm256_mask_i32gather_epi32(zero, reinterpret_cast<const int*>(level.pPixels), texelIndex, activeLanes, 4));
+	}
+
+	inline Texel8 SampleLevel8(const Texture::MipLevel& level, __m256 u, __m256 v, bool isBilinear, __m256i activeLanes)
+	{
+		const __m256 width{ _mm256_set1_ps(float(level.width)) };
+		const __m256 height{ _mm256_set1_ps(float(level.height)) };
+		if (!isBilinear)
+		{
+			return FetchTexels8(level, _mm256_cvttps_epi32(_mm256_mul_ps(u, width)), _mm256_cvttps_epi32(_mm256_mul_ps(v, height)), activeLanes);
+		}
+
+		//same as Texture::SampleBilinear, texel centers sit on half coordinates
+		const __m256 half{ _mm256_set1_ps(0.5f) };
+		const __m256 x{ _mm256_fmsub_ps(u, width, half) };
+		const __m256 y{ _mm256_fmsub_ps(v, height, half) };
+		const __m256 floorX{ _mm256_floor_ps(x) };
+		const __m256 floorY{ _mm256_floor_ps(y) };
+		const __m256 fractionX{ _mm256_sub_ps(x, floorX) };
+		const __m256 fractionY{ _mm256_sub_ps(y, floorY) };
+
+		const __m256i x0{ _mm256_cvtps_epi32(floorX) };
+		const __m256i y0{ _mm256_cvtps_epi32(floorY) };
+		const __m256i x1{ _mm256_add_epi32(x0, _mm256_set1_epi32(1)) };
+		const __m256i y1{ _mm256_add_epi32(y0, _mm256_set1_epi32(1)) };
+
+		const Texel8 top{ Texel8::Lerp(FetchTexels8(level, x0, y0, activeLanes), FetchTexels8(level, x1, y0, activeLanes), fractionX) };
+		const Texel8 bottom{ Texel8::Lerp(FetchTexels8(level, x0, y1, activeLanes), FetchTexels8(level, x1, y1, activeLanes), fractionX) };
+		return Texel8::Lerp(top, bottom, fractionY);
+	}
+
+	//same result as Texture::Sample with a lod, the lod is per triangle so every lane uses the same levels
+	inline Texel8 SampleTexture8(const Texture* pTexture, __m256 u, __m256 v, float uvLod, Texture::Filter filter, int laneMask)
+	{
+		const __m256i laneBits{ _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128) };
+		const __m256i activeLanes{ _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(laneMask), laneBits), laneBits) };
+
+		int level0{}, level1{};
+		float blend{};
+		pTexture->SelectLevels(uvLod, filter, level0, level1, blend);
+
+		const Texel8 sample0{ SampleLevel8(pTexture->GetLevel(level0), u, v, filter != Texture::Filter::Point, activeLanes) };
+		if (filter != Texture::Filter::Trilinear || blend == 0.f) return sample0;
+
+		const Texel8 sample1{ SampleLevel8(pTexture->GetLevel(level1), u, v, true, activeLanes) };
+		return Texel8::Lerp(sample0, sample1, _mm256_set1_ps(blend));
+	}
+}
+#endif
@@ -0,0 +1,107 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+
+using namespace dae;
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	//the thread calling ParallelFor also works, so one less worker is needed
+	const uint32_t workerCount{ threadCount > 1 ? threadCount - 1 : 0 };
+
+	m_Workers.reserve(workerCount);
+	for (uint32_t i{}; i < workerCount; ++i)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_JobAvailable.notify_all();
+
+	for (auto& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+{
+	if (count == 0) return;
+
+	std::atomic<uint32_t> nextIndex{ 0 };
+
+	//every helper keeps pulling indices until there are none left
+	auto runJobs = [&]()
+		{
+			for (uint32_t i{ nextIndex++ }; i < count; i = nextIndex++)
+			{
+				job(i);
+			}
+		};
+
+	//no point in waking more workers than there are jobs
+	const uint32_t helperCount{ std::min(static_cast<uint32_t>(m_Workers.size()), count - 1) };
+	uint32_t helpersDone{ 0 };
+	std::condition_variable helperFinished{};
+
+	{
+		std::lock_guard lock{ m_Mutex };
+		for (uint32_t i{}; i < helperCount; ++i)
+		{
+			m_Jobs.emplace([&]()
+				{
+					runJobs();
+
+					std::lock_guard doneLock{ m_Mutex };
+					++helpersDone;
+					helperFinished.notify_one();
+				});
+		}
+	}
+	m_JobAvailable.notify_all();
+
+	runJobs();
+
+	//helpers reference this stack frame, so wait until every one of them has left
+	std::unique_lock lock{ m_Mutex };
+	helperFinished.wait(lock, [&]() { return helpersDone == helperCount; });
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	if (m_Workers.empty())
+	{
+		job();
+		return;
+	}
+
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_Jobs.push(std::move(job));
+	}
+	m_JobAvailable.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job{};
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_JobAvailable.wait(lock, [this]() { return m_IsStopping || !m_Jobs.empty(); });
+
+			if (m_IsStopping && m_Jobs.empty()) return;
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop();
+		}
+		job();
+	}
+}
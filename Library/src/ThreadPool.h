@@ -0,0 +1,47 @@
+#pragma once
+
+//Standard includes
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	//fixed size pool of worker threads, spun up once and reused every frame
+	class ThreadPool final
+	{
+	public:
+		explicit ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		//runs job(i) for every i in [0, count) and blocks until all of them are done
+		//the calling thread helps out, so this also works with a pool of 0 workers
+		//every call queues its helpers behind whatever is already queued, one pool shouldn't serve callers that can't wait on each other
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+		//queues job for the workers and returns right away, nothing waits for it
+		//without workers there is no one to hand it to, so then it runs on the spot
+		void Submit(std::function<void()> job);
+
+		uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()) + 1; };
+
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread> m_Workers{};
+		std::queue<std::function<void()>> m_Jobs{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_JobAvailable{};
+		bool m_IsStopping{ false };
+	};
+}
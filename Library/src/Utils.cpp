@@ -0,0 +1,392 @@
+#include "Utils.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+namespace dae
+{
+	namespace
+	{
+		//the position/uv/normal indices of a face corner, 1 based like the file, 0 where the corner has none
+		//corners with the same three indices are the same vertex
+		struct ObjCorner
+		{
+			uint32_t position{};
+			uint32_t uv{};
+			uint32_t normal{};
+
+			bool operator==(const ObjCorner& other) const
+			{
+				return position == other.position && uv == other.uv && normal == other.normal;
+			}
+		};
+
+		size_t HashCorner(const ObjCorner& corner)
+		{
+			//multiply-add over the three indices, the shift brings the well mixed high bits down for the buckets
+			uint64_t hash{ corner.position };
+			hash = hash * 0x9E3779B97F4A7C15ull + corner.uv;
+			hash = hash * 0x9E3779B97F4A7C15ull + corner.normal;
+			return static_cast<size_t>(hash ^ (hash >> 29));
+		}
+
+		//a corner as one chunk saw it, negative (relative) indices can point into earlier chunks
+		//those are kept relative to the chunk start until the merge knows where the chunk begins
+		struct ObjChunkCorner
+		{
+			int32_t indices[3]{}; //position, uv, normal
+			uint8_t relativeMask{}; //bit per index that is chunk relative and 0 based
+		};
+
+		//everything one line aligned chunk of the file held, 3 corners per triangle
+		struct ObjChunk
+		{
+			const char* pBegin{};
+			const char* pEnd{};
+			std::vector<Vector3> positions{};
+			std::vector<Vector2> uvs{};
+			std::vector<Vector3> normals{};
+			std::vector<ObjChunkCorner> corners{};
+		};
+
+		const char* SkipSpaces(const char* p, const char* pEnd)
+		{
+			while (p < pEnd && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+			return p;
+		}
+
+		//from_chars skips no whitespace and takes no leading '+', nothing is read if there is no number
+		const char* ParseFloat(const char* p, const char* pEnd, float& value)
+		{
+			p = SkipSpaces(p, pEnd);
+			if (p < pEnd && *p == '+') ++p;
+			value = 0.f;
+			return std::from_chars(p, pEnd, value).ptr;
+		}
+
+		const char* ParseInt(const char* p, const char* pEnd, int32_t& value)
+		{
+			value = 0;
+			return std::from_chars(p, pEnd, value).ptr;
+		}
+
+		void ParseFace(const char* p, const char* pLineEnd, ObjChunk& chunk, std::vector<ObjChunkCorner>& polygon)
+		{
+			const int32_t counts[3]{ int32_t(chunk.positions.size()), int32_t(chunk.uvs.size()), int32_t(chunk.normals.size()) };
+
+			//v, v/vt, v//vn or v/vt/vn per corner
+			polygon.clear();
+			while (true)
+			{
+				p = SkipSpaces(p, pLineEnd);
+				ObjChunkCorner corner{};
+				const char* pNext{ ParseInt(p, pLineEnd, corner.indices[0]) };
+				if (pNext == p) break;
+				p = pNext;
+
+				if (p < pLineEnd && *p == '/')
+				{
+					++p;
+					if (p < pLineEnd && *p != '/') p = ParseInt(p, pLineEnd, corner.indices[1]);
+					if (p < pLineEnd && *p == '/') p = ParseInt(p + 1, pLineEnd, corner.indices[2]);
+				}
+
+				//-1 is the last one defined so far, which might be in an earlier chunk
+				for (int i{}; i < 3; ++i)
+				{
+					if (corner.indices[i] >= 0) continue;
+					corner.indices[i] += counts[i];
+					corner.relativeMask |= uint8_t(1 << i);
+				}
+				polygon.push_back(corner);
+			}
+
+			//fan, a triangle stays a triangle
+			for (size_t i{ 1 }; i + 1 < polygon.size(); ++i)
+			{
+				chunk.corners.push_back(polygon[0]);
+				chunk.corners.push_back(polygon[i]);
+				chunk.corners.push_back(polygon[i + 1]);
+			}
+		}
+
+		void ParseChunk(ObjChunk& chunk)
+		{
+			std::vector<ObjChunkCorner> polygon{};
+			for (const char* pLine{ chunk.pBegin }; pLine < chunk.pEnd;)
+			{
+				const char* pLineEnd{ static_cast<const char*>(std::memchr(pLine, '\n', chunk.pEnd - pLine)) };
+				if (pLineEnd == nullptr) pLineEnd = chunk.pEnd;
+
+				//comments, groups, materials and everything else just fall through
+				const char* p{ SkipSpaces(pLine, pLineEnd) };
+				const auto isKeyword{ [p, pLineEnd](const char* keyword, size_t length)
+					{
+						return size_t(pLineEnd - p) > length && std::memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+					} };
+
+				if (isKeyword("v", 1))
+				{
+					Vector3 position{};
+					p = ParseFloat(p + 1, pLineEnd, position.x);
+					p = ParseFloat(p, pLineEnd, position.y);
+					ParseFloat(p, pLineEnd, position.z);
+					chunk.positions.push_back(position);
+				}
+				else if (isKeyword("vt", 2))
+				{
+					Vector2 uv{};
+					p = ParseFloat(p + 2, pLineEnd, uv.x);
+					ParseFloat(p, pLineEnd, uv.y);
+					chunk.uvs.emplace_back(uv.x, 1 - uv.y);
+				}
+				else if (isKeyword("vn", 2))
+				{
+					Vector3 normal{};
+					p = ParseFloat(p + 2, pLineEnd, normal.x);
+					p = ParseFloat(p, pLineEnd, normal.y);
+					ParseFloat(p, pLineEnd, normal.z);
+					chunk.normals.push_back(normal);
+				}
+				else if (isKeyword("f", 1))
+				{
+					ParseFace(p + 1, pLineEnd, chunk, polygon);
+				}
+
+				pLine = pLineEnd + 1;
+			}
+		}
+
+		void RunJobs(ThreadPool* pThreadPool, uint32_t count, const std::function<void(uint32_t)>& job)
+		{
+			if (pThreadPool != nullptr)
+			{
+				pThreadPool->ParallelFor(count, job);
+				return;
+			}
+			for (uint32_t i{}; i < count; ++i)
+			{
+				job(i);
+			}
+		}
+	}
+
+	bool Utils::ParseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding, ThreadPool* pThreadPool)
+	{
+#ifdef DISABLE_OBJ
+
+		//TODO: Enable the code below after uncommenting all the vertex attributes of DataTypes::Vertex
+		// >> Comment/Remove '#define DISABLE_OBJ'
+		assert(false && "OBJ PARSER not enabled! Check the comments in Utils::ParseOBJ");
+		return false;
+
+#else
+
+		const MappedFile file{ filename };
+		if (!file.IsOpen())
+			return false;
+
+		vertices.clear();
+		indices.clear();
+
+		//a few chunks per thread so a chunk full of faces doesn't hold everyone up, but none smaller than 256KB
+		constexpr size_t minChunkSize{ 256 * 1024 };
+		const char* pData{ file.GetData() };
+		const size_t size{ file.GetSize() };
+		const size_t maxChunkCount{ pThreadPool != nullptr ? size_t(pThreadPool->GetThreadCount()) * 4 : 1 };
+		const size_t chunkCount{ std::max(size_t(1), std::min(maxChunkCount, size / minChunkSize)) };
+
+		//every chunk ends right after a newline
+		std::vector<ObjChunk> chunks(chunkCount);
+		const char* pChunkBegin{ pData };
+		for (size_t i{}; i < chunkCount; ++i)
+		{
+			const char* pChunkEnd{ pData + size };
+			if (i + 1 < chunkCount)
+			{
+				pChunkEnd = std::max(pChunkBegin, pData + size * (i + 1) / chunkCount);
+				const char* pNewline{ static_cast<const char*>(std::memchr(pChunkEnd, '\n', pData + size - pChunkEnd)) };
+				pChunkEnd = pNewline != nullptr ? pNewline + 1 : pData + size;
+			}
+			chunks[i].pBegin = pChunkBegin;
+			chunks[i].pEnd = pChunkEnd;
+			pChunkBegin = pChunkEnd;
+		}
+
+		RunJobs(pThreadPool, uint32_t(chunkCount), [&chunks](uint32_t i) { ParseChunk(chunks[i]); });
+
+		//prefix sums give every chunk its place in the merged arrays
+		std::vector<size_t> positionOffsets(chunkCount + 1, 0);
+		std::vector<size_t> uvOffsets(chunkCount + 1, 0);
+		std::vector<size_t> normalOffsets(chunkCount + 1, 0);
+		std::vector<size_t> cornerOffsets(chunkCount + 1, 0);
+		for (size_t i{}; i < chunkCount; ++i)
+		{
+			positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+			uvOffsets[i + 1] = uvOffsets[i] + chunks[i].uvs.size();
+			normalOffsets[i + 1] = normalOffsets[i] + chunks[i].normals.size();
+			cornerOffsets[i + 1] = cornerOffsets[i] + chunks[i].corners.size();
+		}
+
+		std::vector<Vector3> positions(positionOffsets[chunkCount]);
+		std::vector<Vector2> UVs(uvOffsets[chunkCount]);
+		std::vector<Vector3> normals(normalOffsets[chunkCount]);
+		std::vector<ObjCorner> corners(cornerOffsets[chunkCount]);
+		RunJobs(pThreadPool, uint32_t(chunkCount), [&](uint32_t i)
+			{
+				const ObjChunk& chunk{ chunks[i] };
+				std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionOffsets[i]);
+				std::copy(chunk.uvs.begin(), chunk.uvs.end(), UVs.begin() + uvOffsets[i]);
+				std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalOffsets[i]);
+
+				//relative indices become absolute 1 based ones like the rest
+				const int64_t chunkStarts[3]{ int64_t(positionOffsets[i]), int64_t(uvOffsets[i]), int64_t(normalOffsets[i]) };
+				for (size_t c{}; c < chunk.corners.size(); ++c)
+				{
+					const ObjChunkCorner& chunkCorner{ chunk.corners[c] };
+					uint32_t absolute[3]{};
+					for (int k{}; k < 3; ++k)
+					{
+						const int64_t index{ (chunkCorner.relativeMask & (1 << k)) != 0 ? chunkStarts[k] + chunkCorner.indices[k] + 1 : chunkCorner.indices[k] };
+						absolute[k] = index > 0 ? uint32_t(index) : 0;
+					}
+					corners[cornerOffsets[i] + c] = ObjCorner{ absolute[0], absolute[1], absolute[2] };
+				}
+			});
+
+		//open addressing with linear probing, the key sits in the slot so a lookup touches one cache line
+		//a corner seen before reuses its vertex, the tangents below then add up over every face sharing it
+		struct CornerSlot
+		{
+			ObjCorner corner{};
+			uint32_t vertex{}; //vertex index + 1, 0 is empty
+		};
+		size_t tableSize{ 16 };
+		while (tableSize < positions.size() * 2) tableSize *= 2;
+		std::vector<CornerSlot> slots(tableSize);
+		indices.reserve(corners.size());
+
+		const auto findSlot{ [](std::vector<CornerSlot>& table, const ObjCorner& corner) -> CornerSlot&
+			{
+				size_t slot{ HashCorner(corner) & (table.size() - 1) };
+				while (table[slot].vertex != 0 && !(table[slot].corner == corner))
+				{
+					slot = (slot + 1) & (table.size() - 1);
+				}
+				return table[slot];
+			} };
+
+		for (size_t i{}; i < corners.size(); i += 3)
+		{
+			uint32_t tempIndices[3];
+			for (size_t iFace = 0; iFace < 3; iFace++)
+			{
+				ObjCorner corner{ corners[i + iFace] };
+				if (corner.position == 0 || corner.position > positions.size())
+					return false;
+				if (corner.uv > UVs.size()) corner.uv = 0;
+				if (corner.normal > normals.size()) corner.normal = 0;
+
+				CornerSlot& slot{ findSlot(slots, corner) };
+				if (slot.vertex != 0)
+				{
+					tempIndices[iFace] = slot.vertex - 1;
+				}
+				else
+				{
+					// OBJ format uses 1-based arrays
+					Vertex vertex{};
+					vertex.position = positions[corner.position - 1];
+					if (corner.uv != 0) vertex.uv = UVs[corner.uv - 1];
+					if (corner.normal != 0) vertex.normal = normals[corner.normal - 1];
+					vertices.push_back(vertex);
+					slot = CornerSlot{ corner, uint32_t(vertices.size()) };
+					tempIndices[iFace] = uint32_t(vertices.size() - 1);
+
+					//keep it at most half full, seams can give a position more than one vertex
+					if (vertices.size() * 2 > tableSize)
+					{
+						tableSize *= 2;
+						std::vector<CornerSlot> grownSlots(tableSize);
+						for (const CornerSlot& oldSlot : slots)
+						{
+							if (oldSlot.vertex != 0) findSlot(grownSlots, oldSlot.corner) = oldSlot;
+						}
+						slots.swap(grownSlots);
+					}
+				}
+			}
+
+			indices.push_back(tempIndices[0]);
+			if (flipAxisAndWinding)
+			{
+				indices.push_back(tempIndices[2]);
+				indices.push_back(tempIndices[1]);
+			}
+			else
+			{
+				indices.push_back(tempIndices[1]);
+				indices.push_back(tempIndices[2]);
+			}
+		}
+
+		//Cheap Tangent Calculations
+		for (uint32_t i = 0; i < indices.size(); i += 3)
+		{
+			uint32_t index0 = indices[i];
+			uint32_t index1 = indices[size_t(i) + 1];
+			uint32_t index2 = indices[size_t(i) + 2];
+
+			const Vector3& p0 = vertices[index0].position;
+			const Vector3& p1 = vertices[index1].position;
+			const Vector3& p2 = vertices[index2].position;
+			const Vector2& uv0 = vertices[index0].uv;
+			const Vector2& uv1 = vertices[index1].uv;
+			const Vector2& uv2 = vertices[index2].uv;
+
+			const Vector3 edge0 = p1 - p0;
+			const Vector3 edge1 = p2 - p0;
+			const Vector2 diffX = Vector2(uv1.x - uv0.x, uv2.x - uv0.x);
+			const Vector2 diffY = Vector2(uv1.y - uv0.y, uv2.y - uv0.y);
+
+			//no uv area means no tangent, with shared vertices its inf would spread to every neighbouring face
+			const float uvArea = Vector2::Cross(diffX, diffY);
+			if (uvArea == 0.f) continue;
+			float r = 1.f / uvArea;
+
+			Vector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
+			vertices[index0].tangent += tangent;
+			vertices[index1].tangent += tangent;
+			vertices[index2].tangent += tangent;
+		}
+
+		//Fix the tangents per vertex now because we accumulated
+		for (auto& v : vertices)
+		{
+			//a vertex whose faces all had no uv area has no tangent, any one perpendicular to the normal keeps NaNs out of the shading
+			const Vector3 rejected = Vector3::Reject(v.tangent, v.normal);
+			const float rejectedLength = rejected.SqrMagnitude();
+			if (rejectedLength > 0.f && std::isfinite(rejectedLength))
+				v.tangent = rejected.Normalized();
+			else if (v.normal.SqrMagnitude() > 0.f)
+				v.tangent = Vector3::Cross(v.normal, std::abs(v.normal.x) < 0.9f * v.normal.Magnitude() ? Vector3::UnitX : Vector3::UnitY).Normalized();
+			else
+				v.tangent = Vector3::UnitX;
+
+			if(flipAxisAndWinding)
+			{
+				v.position.z *= -1.f;
+				v.normal.z *= -1.f;
+				v.tangent.z *= -1.f;
+			}
+
+		}
+
+		return true;
+#endif
+	}
+}
@@ -0,0 +1,117 @@
+#include "VertexStream.h"
+#include <limits>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr float g_MaxElement{ 32767.f }; //-32768 is left out so the range is symmetric
+		constexpr float g_OctahedralScale{ 1.f / g_MaxElement };
+
+		//x and y of the point of the octahedron n goes through, the lower half folded over the diagonals
+		Vector2 EncodeOctahedral(const Vector3& n)
+		{
+			const float length{ std::abs(n.x) + std::abs(n.y) + std::abs(n.z) };
+			const Vector2 p{ n.x / length, n.y / length };
+			if (n.z >= 0.f) return p;
+			return Vector2{ (1.f - std::abs(p.y)) * (p.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(p.x)) * (p.y >= 0.f ? 1.f : -1.f) };
+		}
+
+		//rounding x and y on their own isn't always the closest on the sphere, so the best of the four around it is kept
+		void PackOctahedral(const Vector3& n, int16_t& x, int16_t& y)
+		{
+			const Vector2 p{ EncodeOctahedral(n) };
+			const float floorX{ std::floor(p.x * g_MaxElement) };
+			const float floorY{ std::floor(p.y * g_MaxElement) };
+			float bestDot{ -2.f };
+			for (int corner{}; corner < 4; ++corner)
+			{
+				const float qx{ std::clamp(floorX + float(corner & 1), -g_MaxElement, g_MaxElement) };
+				const float qy{ std::clamp(floorY + float(corner >> 1), -g_MaxElement, g_MaxElement) };
+				const float dot{ Vector3::Dot(DecodeOctahedral(qx * g_OctahedralScale, qy * g_OctahedralScale), n) };
+				if (dot > bestDot)
+				{
+					bestDot = dot;
+					x = int16_t(qx);
+					y = int16_t(qy);
+				}
+			}
+		}
+
+		bool IsUsableDirection(const Vector3& v)
+		{
+			const float sqrMagnitude{ v.SqrMagnitude() };
+			return std::isfinite(sqrMagnitude) && sqrMagnitude > 0.f;
+		}
+	}
+
+	void PackVertices(const std::vector<Vertex>& vertices, VertexInStream& stream, VertexQuantization& quantization)
+	{
+		using C = VertexInLayout;
+
+		//everything in front of the normal is a plain float stored relative to its range
+		constexpr int plainCount{ C::NormalX };
+		const auto getPlain{ [](const Vertex& vertex, float values[plainCount])
+			{
+				values[C::PositionX] = vertex.position.x;
+				values[C::PositionY] = vertex.position.y;
+				values[C::PositionZ] = vertex.position.z;
+				values[C::ColorR] = vertex.color.r;
+				values[C::ColorG] = vertex.color.g;
+				values[C::ColorB] = vertex.color.b;
+				values[C::U] = vertex.uv.x;
+				values[C::V] = vertex.uv.y;
+			} };
+
+		float mins[plainCount]{}, maxs[plainCount]{};
+		std::fill(mins, mins + plainCount, std::numeric_limits<float>::max());
+		std::fill(maxs, maxs + plainCount, std::numeric_limits<float>::lowest());
+		for (const Vertex& vertex : vertices)
+		{
+			float values[plainCount]{};
+			getPlain(vertex, values);
+			for (int component{}; component < plainCount; ++component)
+			{
+				mins[component] = std::min(mins[component], values[component]);
+				maxs[component] = std::max(maxs[component], values[component]);
+			}
+		}
+
+		//[min, max] maps onto [-32767, 32767], a component that never changes gets scale 0 and comes back exactly
+		quantization = VertexQuantization{};
+		for (int component{}; component < plainCount && !vertices.empty(); ++component)
+		{
+			quantization.offset[component] = (mins[component] + maxs[component]) * 0.5f;
+			quantization.scale[component] = (maxs[component] - mins[component]) * 0.5f / g_MaxElement;
+		}
+		for (int component{ plainCount }; component < C::ComponentCount; ++component)
+		{
+			quantization.scale[component] = g_OctahedralScale;
+		}
+
+		stream.Resize(vertices.size());
+		for (size_t i{}; i < vertices.size(); ++i)
+		{
+			const Vertex& vertex{ vertices[i] };
+			float values[plainCount]{};
+			getPlain(vertex, values);
+			for (int component{}; component < plainCount; ++component)
+			{
+				const float scale{ quantization.scale[component] };
+				const float element{ scale != 0.f ? std::round((values[component] - quantization.offset[component]) / scale) : 0.f };
+				stream.Get(component)[i] = int16_t(std::clamp(element, -g_MaxElement, g_MaxElement));
+			}
+
+			//the octahedron can't hold a zero or NaN, those get a direction that at least shades
+			const Vector3 normal{ IsUsableDirection(vertex.normal) ? vertex.normal.Normalized() : Vector3{ 0.f, 0.f, 1.f } };
+			Vector3 tangent{ vertex.tangent };
+			if (!IsUsableDirection(tangent))
+			{
+				const Vector3 axis{ std::abs(normal.x) < 0.9f ? Vector3{ 1.f, 0.f, 0.f } : Vector3{ 0.f, 1.f, 0.f } };
+				tangent = Vector3::Cross(normal, axis);
+			}
+			PackOctahedral(normal, stream.Get(C::NormalX)[i], stream.Get(C::NormalY)[i]);
+			PackOctahedral(tangent.Normalized(), stream.Get(C::TangentX)[i], stream.Get(C::TangentY)[i]);
+		}
+	}
+}
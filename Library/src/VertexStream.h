@@ -0,0 +1,294 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "DataTypes.h"
+#include "SIMDMath.h"
+
+namespace dae
+{
+	//vertices in structure of arrays form, one array of Layout::Element per component
+	//every array is 32 byte aligned and padded to a whole block of 8, so the SIMD vertex stage loads and stores without a tail
+	template<typename Layout>
+	class VertexStream final
+	{
+	public:
+		using Element = typename Layout::Element;
+		static constexpr size_t BlockSize{ 8 };
+
+		VertexStream() = default;
+		~VertexStream()
+		{
+			if (m_OwnsData) ::operator delete[](m_pData, std::align_val_t{ 32 });
+		}
+
+		VertexStream(const VertexStream&) = delete;
+		VertexStream(VertexStream&&) noexcept = delete;
+		VertexStream& operator=(const VertexStream&) = delete;
+		VertexStream& operator=(VertexStream&&) noexcept = delete;
+
+		//keeps the allocation when it is big enough, only the padding is cleared, everything else is left as it was
+		void Resize(size_t count)
+		{
+			const size_t paddedCount{ (count + BlockSize - 1) / BlockSize * BlockSize };
+			if (paddedCount > m_Capacity || !m_OwnsData)
+			{
+				if (m_OwnsData) ::operator delete[](m_pData, std::align_val_t{ 32 });
+				m_pData = static_cast<Element*>(::operator new[](paddedCount * Layout::ComponentCount * sizeof(Element), std::align_val_t{ 32 }));
+				m_Capacity = paddedCount;
+				m_OwnsData = true;
+			}
+			m_Count = count;
+
+			//the padding lanes go through the vertex stage too, nothing reads their results but they start out as plain zeros
+			for (int component{}; component < Layout::ComponentCount; ++component)
+			{
+				std::fill(Get(component) + count, Get(component) + paddedCount, Element{});
+			}
+		}
+
+		//points the stream at arrays laid out like its own (capacity elements apart, 32 byte aligned) that someone else owns
+		//meant for a mapped mesh cache, the data is read only so only the const accessors may be used until the next Resize
+		void View(const Element* pData, size_t count, size_t capacity)
+		{
+			if (m_OwnsData) ::operator delete[](m_pData, std::align_val_t{ 32 });
+			m_pData = const_cast<Element*>(pData);
+			m_Count = count;
+			m_Capacity = capacity;
+			m_OwnsData = false;
+		}
+
+		//hands the data over whole, owned or viewed, e.g. a stream built off the main thread
+		void Swap(VertexStream& other) noexcept
+		{
+			std::swap(m_pData, other.m_pData);
+			std::swap(m_Count, other.m_Count);
+			std::swap(m_Capacity, other.m_Capacity);
+			std::swap(m_OwnsData, other.m_OwnsData);
+		}
+
+		Element* Get(int component) { return m_pData + component * m_Capacity; }
+		const Element* Get(int component) const { return m_pData + component * m_Capacity; }
+		size_t GetCount() const { return m_Count; }
+		size_t GetCapacity() const { return m_Capacity; }
+
+	private:
+		Element* m_pData{};
+		size_t m_Count{};
+		size_t m_Capacity{}; //per component, a multiple of BlockSize
+		bool m_OwnsData{ true };
+	};
+
+	//what the vertex stage reads, Vertex without the view direction it computes itself
+	//16 bit fixed point instead of floats, 24 bytes a vertex instead of 56, VertexQuantization turns them back into floats
+	//normal and tangent are octahedral, the unit sphere folded onto a square, two components each
+	struct VertexInLayout
+	{
+		using Element = int16_t;
+
+		enum Component
+		{
+			PositionX, PositionY, PositionZ,
+			ColorR, ColorG, ColorB,
+			U, V,
+			NormalX, NormalY,
+			TangentX, TangentY,
+			ComponentCount
+		};
+	};
+
+	//value = offset + element * scale, per component
+	//the ranges come from the mesh itself, so all 16 bits go to the part of the range it uses (positions relative to the bounds)
+	struct VertexQuantization
+	{
+		float offset[VertexInLayout::ComponentCount]{};
+		float scale[VertexInLayout::ComponentCount]{};
+	};
+
+	//what it writes, Vertex_Out with the position divided by w (w kept) plus the clip space position for the clipper
+	struct VertexOutLayout
+	{
+		using Element = float;
+
+		enum Component
+		{
+			PositionX, PositionY, PositionZ, PositionW,
+			ClipX, ClipY, ClipZ, //clip w is PositionW
+			ColorR, ColorG, ColorB,
+			U, V,
+			NormalX, NormalY, NormalZ,
+			TangentX, TangentY, TangentZ,
+			ViewX, ViewY, ViewZ,
+			ComponentCount
+		};
+	};
+
+	using VertexInStream = VertexStream<VertexInLayout>;
+	using VertexOutStream = VertexStream<VertexOutLayout>;
+
+	//quantizes the whole mesh into stream, the ranges are measured first (VertexStream.cpp)
+	//a normal or tangent that is zero or not a number goes in as some unit vector, one perpendicular to the normal for a tangent
+	void PackVertices(const std::vector<Vertex>& vertices, VertexInStream& stream, VertexQuantization& quantization);
+
+	//the point of the octahedron that (x, y) unfolds to, normalized, x and y in [-1, 1]
+	inline Vector3 DecodeOctahedral(float x, float y)
+	{
+		//the lower half was folded over the diagonals onto the corners
+		const float z{ 1.f - std::abs(x) - std::abs(y) };
+		const float fold{ std::max(-z, 0.f) };
+		x += x >= 0.f ? -fold : fold;
+		y += y >= 0.f ? -fold : fold;
+		return Vector3{ x, y, z }.Normalized();
+	}
+
+	//scalar access, for the stages after the vertex stage that work per triangle and for the vertex stage without AVX2
+	inline Vertex LoadVertex(const VertexInStream& stream, const VertexQuantization& quantization, size_t i)
+	{
+		using C = VertexInLayout;
+		const auto load{ [&](int component) { return float(stream.Get(component)[i]) * quantization.scale[component] + quantization.offset[component]; } };
+
+		Vertex vertex{};
+		vertex.position = Vector3{ load(C::PositionX), load(C::PositionY), load(C::PositionZ) };
+		vertex.color = ColorRGB{ load(C::ColorR), load(C::ColorG), load(C::ColorB) };
+		vertex.uv = Vector2{ load(C::U), load(C::V) };
+		vertex.normal = DecodeOctahedral(load(C::NormalX), load(C::NormalY));
+		vertex.tangent = DecodeOctahedral(load(C::TangentX), load(C::TangentY));
+		return vertex;
+	}
+
+	//vertex.position is clip space, the stream gets it as is and divided by w
+	inline void StoreVertex(VertexOutStream& stream, size_t i, const Vertex_Out& vertex)
+	{
+		using C = VertexOutLayout;
+		const Vector4& p{ vertex.position };
+		const float values[C::ComponentCount]{
+			p.x / p.w, p.y / p.w, p.z / p.w, p.w,
+			p.x, p.y, p.z,
+			vertex.color.r, vertex.color.g, vertex.color.b,
+			vertex.uv.x, vertex.uv.y,
+			vertex.normal.x, vertex.normal.y, vertex.normal.z,
+			vertex.tangent.x, vertex.tangent.y, vertex.tangent.z,
+			vertex.viewDirection.x, vertex.viewDirection.y, vertex.viewDirection.z };
+		for (int component{}; component < C::ComponentCount; ++component) stream.Get(component)[i] = values[component];
+	}
+
+	//position divided by w, like vertices_out used to be
+	inline Vector4 LoadPosition(const VertexOutStream& stream, size_t i)
+	{
+		using C = VertexOutLayout;
+		return Vector4{ stream.Get(C::PositionX)[i], stream.Get(C::PositionY)[i], stream.Get(C::PositionZ)[i], stream.Get(C::PositionW)[i] };
+	}
+
+	inline Vector4 LoadClipPosition(const VertexOutStream& stream, size_t i)
+	{
+		using C = VertexOutLayout;
+		return Vector4{ stream.Get(C::ClipX)[i], stream.Get(C::ClipY)[i], stream.Get(C::ClipZ)[i], stream.Get(C::PositionW)[i] };
+	}
+
+	inline Vertex_Out LoadVertex(const VertexOutStream& stream, size_t i)
+	{
+		using C = VertexOutLayout;
+		Vertex_Out vertex{};
+		vertex.position = LoadPosition(stream, i);
+		vertex.color = ColorRGB{ stream.Get(C::ColorR)[i], stream.Get(C::ColorG)[i], stream.Get(C::ColorB)[i] };
+		vertex.uv = Vector2{ stream.Get(C::U)[i], stream.Get(C::V)[i] };
+		vertex.normal = Vector3{ stream.Get(C::NormalX)[i], stream.Get(C::NormalY)[i], stream.Get(C::NormalZ)[i] };
+		vertex.tangent = Vector3{ stream.Get(C::TangentX)[i], stream.Get(C::TangentY)[i], stream.Get(C::TangentZ)[i] };
+		vertex.viewDirection = Vector3{ stream.Get(C::ViewX)[i], stream.Get(C::ViewY)[i], stream.Get(C::ViewZ)[i] };
+		return vertex;
+	}
+
+#ifdef __AVX2__
+	//one block of the streams in registers, what VertexShader8 takes and returns
+	struct Vertex8
+	{
+		Vector3x8 position{};
+		Vector3x8 color{};
+		__m256 u{};
+		__m256 v{};
+		Vector3x8 normal{};
+		Vector3x8 tangent{};
+	};
+
+	struct VertexOut8
+	{
+		Vector4x8 position{}; //clip space
+		Vector3x8 color{};
+		__m256 u{};
+		__m256 v{};
+		Vector3x8 normal{};
+		Vector3x8 tangent{};
+		Vector3x8 viewDirection{};
+	};
+
+	//DecodeOctahedral for 8 at once, the fold as a subtraction of fold with x's sign (x is never -0 here)
+	inline Vector3x8 DecodeOctahedral8(__m256 x, __m256 y)
+	{
+		const __m256 signMask{ _mm256_set1_ps(-0.f) };
+		const __m256 z{ _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_andnot_ps(signMask, x)), _mm256_andnot_ps(signMask, y)) };
+		const __m256 fold{ _mm256_max_ps(_mm256_sub_ps(_mm256_setzero_ps(), z), _mm256_setzero_ps()) };
+		x = _mm256_sub_ps(x, _mm256_or_ps(fold, _mm256_and_ps(x, signMask)));
+		y = _mm256_sub_ps(y, _mm256_or_ps(fold, _mm256_and_ps(y, signMask)));
+
+		//the same divide by the length as Normalized, so both paths give the same bits
+		const __m256 length{ _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z))) };
+		return { _mm256_div_ps(x, length), _mm256_div_ps(y, length), _mm256_div_ps(z, length) };
+	}
+
+	//first has to be a multiple of BlockSize, 8 elements are 16 bytes so every load is aligned
+	inline Vertex8 LoadVertex8(const VertexInStream& stream, const VertexQuantization& quantization, size_t first)
+	{
+		using C = VertexInLayout;
+		const auto load{ [&stream, &quantization, first](int component)
+			{
+				const __m128i elements{ _mm_load_si128(reinterpret_cast<const __m128i*>(stream.Get(component) + first)) };
+				const __m256 values{ _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(elements)) };
+				return _mm256_add_ps(_mm256_mul_ps(values, _mm256_set1_ps(quantization.scale[component])), _mm256_set1_ps(quantization.offset[component]));
+			} };
+
+		Vertex8 vertices{};
+		vertices.position = { load(C::PositionX), load(C::PositionY), load(C::PositionZ) };
+		vertices.color = { load(C::ColorR), load(C::ColorG), load(C::ColorB) };
+		vertices.u = load(C::U);
+		vertices.v = load(C::V);
+		vertices.normal = DecodeOctahedral8(load(C::NormalX), load(C::NormalY));
+		vertices.tangent = DecodeOctahedral8(load(C::TangentX), load(C::TangentY));
+		return vertices;
+	}
+
+	//StoreVertex for a whole block, same divide so both paths give the same bits
+	inline void StoreVertex8(VertexOutStream& stream, size_t first, const VertexOut8& vertices)
+	{
+		using C = VertexOutLayout;
+		const auto store{ [&stream, first](int component, __m256 value) { _mm256_store_ps(stream.Get(component) + first, value); } };
+
+		const Vector4x8& p{ vertices.position };
+		store(C::PositionX, _mm256_div_ps(p.x, p.w));
+		store(C::PositionY, _mm256_div_ps(p.y, p.w));
+		store(C::PositionZ, _mm256_div_ps(p.z, p.w));
+		store(C::PositionW, p.w);
+		store(C::ClipX, p.x);
+		store(C::ClipY, p.y);
+		store(C::ClipZ, p.z);
+		store(C::ColorR, vertices.color.x);
+		store(C::ColorG, vertices.color.y);
+		store(C::ColorB, vertices.color.z);
+		store(C::U, vertices.u);
+		store(C::V, vertices.v);
+		store(C::NormalX, vertices.normal.x);
+		store(C::NormalY, vertices.normal.y);
+		store(C::NormalZ, vertices.normal.z);
+		store(C::TangentX, vertices.tangent.x);
+		store(C::TangentY, vertices.tangent.y);
+		store(C::TangentZ, vertices.tangent.z);
+		store(C::ViewX, vertices.viewDirection.x);
+		store(C::ViewY, vertices.viewDirection.y);
+		store(C::ViewZ, vertices.viewDirection.z);
+	}
+#endif
+}
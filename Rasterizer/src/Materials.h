@@ -0,0 +1,213 @@
+#pragma once
+
+#include "ShaderProgram.h"
+#include "TextureSIMD.h"
+
+//the built in shader programs, the renderer picks one of these per frame from its toggles
+namespace dae
+{
+	//feature bits of PhongProgram, every combination is its own program with no per pixel branching on them
+	namespace phong
+	{
+		constexpr uint32_t NormalMap{ 1 << 0 };
+		constexpr uint32_t Diffuse{ 1 << 1 };
+		constexpr uint32_t Specular{ 1 << 2 }; //neither diffuse nor specular is the observed area view
+	}
+
+	//lambert diffuse plus phong specular, diffuse map with specular in alpha and normal map with gloss in alpha
+	template<uint32_t Features>
+	class PhongProgram final : public ShaderProgram<PhongProgram<Features>>
+	{
+	public:
+		static constexpr bool UsesNormalMap{ (Features & phong::NormalMap) != 0 };
+		static constexpr bool UsesDiffuse{ (Features & phong::Diffuse) != 0 };
+		static constexpr bool UsesSpecular{ (Features & phong::Specular) != 0 };
+
+		static constexpr uint32_t Varyings{ varyings::Normal
+			| (UsesNormalMap || UsesDiffuse || UsesSpecular ? varyings::UV : 0)
+			| (UsesNormalMap ? varyings::Tangent : 0)
+			| (UsesSpecular ? varyings::ViewDirection : 0) };
+
+		ColorRGB PixelShader(const Vertex_Out& v, float uvLod, const ShaderResources& resources) const
+		{
+			Vector3 normalSample{ v.normal };
+
+			//the alpha channels hold specular and gloss, each texture is fetched at most once
+			Texture::Texel normalTexel{};
+			if constexpr (UsesNormalMap)
+			{
+				normalTexel = resources.pNormalMap->SampleTexel(v.uv, uvLod, resources.textureFilter);
+
+				//slide 12 week 9
+				const Vector3 binormal = Vector3::Cross(normalSample, v.tangent);
+				const Matrix tangentSpaceAxis{ v.tangent, binormal, v.normal, {0,0,0} };
+				const ColorRGB& normalColor = normalTexel.color;
+
+				//bottom slide 19, 255 division happens in Sample
+				normalSample.x = 2.f * normalColor.r - 1.f;
+				normalSample.y = 2.f * normalColor.g - 1.f;
+				normalSample.z = 2.f * normalColor.b - 1.f;
+
+				normalSample = tangentSpaceAxis.TransformVector(normalSample);
+
+				//slide 4, make sure to norm later
+				normalSample.Normalize();
+			}
+			//slide 6 and onwards:
+			//observed area
+			float observedArea{ std::max(Vector3::Dot(normalSample, -resources.lightDirection),0.f) };//todo check if max is fine
+			observedArea = Saturate(observedArea);
+
+			if constexpr (!UsesDiffuse && !UsesSpecular)
+			{
+				return { observedArea, observedArea, observedArea };
+			}
+			else
+			{
+				ColorRGB shadedColor{};
+				const Texture::Texel diffuseTexel = resources.pDiffuseMap->SampleTexel(v.uv, uvLod, resources.textureFilter);
+
+				if constexpr (UsesDiffuse)
+				{
+					const ColorRGB diffuse = diffuseTexel.color * resources.diffuseReflectance / PI;
+					shadedColor = diffuse * observedArea /** m_MainLight.intensity*/;
+				}
+
+				if constexpr (UsesSpecular)
+				{
+					//Phong
+					if constexpr (!UsesNormalMap)
+					{
+						normalTexel = resources.pNormalMap->SampleTexel(v.uv, uvLod, resources.textureFilter);
+					}
+					const float specularity = diffuseTexel.alpha;
+					const float phongExponent = normalTexel.alpha * resources.shininess;
+					const ColorRGB phongColor = Phong(specularity, phongExponent, -resources.lightDirection, v.viewDirection, normalSample);
+
+					//combined adds phong as ambient, specular on its own is lit like diffuse
+					if constexpr (UsesDiffuse)
+					{
+						shadedColor += phongColor * resources.ambientColor/* m_MainLight.color*/;
+					}
+					else
+					{
+						shadedColor = phongColor * observedArea;
+					}
+				}
+
+				return shadedColor;
+			}
+		}
+
+#ifdef __AVX2__
+		Vector3x8 PixelShader8(const PixelBlock8& pixels, const ShaderResources& resources) const
+		{
+			const __m256 zero{ _mm256_setzero_ps() };
+			const __m256 one{ _mm256_set1_ps(1.f) };
+
+			Vector3x8 normalSample{ pixels.normal };
+
+			//the normal map also carries gloss, so it gets fetched here or right before phong
+			Texel8 normalTexels{};
+			if constexpr (UsesNormalMap)
+			{
+				//slide 12 week 9, tangent space to world space
+				const Vector3x8 binormal{ Vector3x8::Cross(pixels.normal, pixels.tangent) };
+				normalTexels = SampleTexture8(resources.pNormalMap, pixels.u, pixels.v, pixels.uvLod, resources.textureFilter, pixels.laneMask);
+				const Vector3x8& normalColor{ normalTexels.color };
+
+				const __m256 two{ _mm256_set1_ps(2.f) };
+				const __m256 tangentX{ _mm256_fmsub_ps(two, normalColor.x, one) };
+				const __m256 tangentY{ _mm256_fmsub_ps(two, normalColor.y, one) };
+				const __m256 tangentZ{ _mm256_fmsub_ps(two, normalColor.z, one) };
+
+				normalSample = (pixels.tangent * tangentX + binormal * tangentY + pixels.normal * tangentZ).Normalized();
+			}
+
+			const Vector3x8 lightDirection{ -resources.lightDirection };
+			const __m256 observedArea{ _mm256_min_ps(_mm256_max_ps(Vector3x8::Dot(normalSample, lightDirection), zero), one) };
+
+			if constexpr (!UsesDiffuse && !UsesSpecular)
+			{
+				return { observedArea, observedArea, observedArea };
+			}
+			else
+			{
+				//diffuse rgb and specular in one fetch
+				const Texel8 diffuseTexels{ SampleTexture8(resources.pDiffuseMap, pixels.u, pixels.v, pixels.uvLod, resources.textureFilter, pixels.laneMask) };
+				const Vector3x8 diffuseLit{ diffuseTexels.color * _mm256_set1_ps(resources.diffuseReflectance / PI) * observedArea };
+				if constexpr (!UsesSpecular)
+				{
+					return diffuseLit;
+				}
+				else
+				{
+					//Phong
+					if constexpr (!UsesNormalMap)
+					{
+						normalTexels = SampleTexture8(resources.pNormalMap, pixels.u, pixels.v, pixels.uvLod, resources.textureFilter, pixels.laneMask);
+					}
+					const __m256 specularity{ diffuseTexels.alpha };
+					const __m256 phongExponent{ _mm256_mul_ps(normalTexels.alpha, _mm256_set1_ps(resources.shininess)) };
+
+					const Vector3x8 reflection{ Vector3x8::Reflect(lightDirection, normalSample) };
+					const __m256 cosAlpha{ _mm256_max_ps(zero, Vector3x8::Dot(reflection, pixels.viewDirection)) };
+					const __m256 phong{ _mm256_mul_ps(specularity, Pow8(cosAlpha, phongExponent)) };
+
+					if constexpr (!UsesDiffuse)
+					{
+						return Vector3x8{ phong, phong, phong } * observedArea;
+					}
+					else
+					{
+						//Combined
+						return {
+							_mm256_fmadd_ps(phong, _mm256_set1_ps(resources.ambientColor.r), diffuseLit.x),
+							_mm256_fmadd_ps(phong, _mm256_set1_ps(resources.ambientColor.g), diffuseLit.y),
+							_mm256_fmadd_ps(phong, _mm256_set1_ps(resources.ambientColor.b), diffuseLit.z) };
+					}
+				}
+			}
+		}
+#endif
+
+	private:
+		//slide 12
+		static ColorRGB Phong(float specularity, float exp, const Vector3& l, const Vector3& v, const Vector3& n)
+		{
+			const Vector3 reflection = Vector3::Reflect(l, n);
+			const float cosAlpha = std::max(0.f, Vector3::Dot(reflection, v));
+			const float value = specularity * powf(cosAlpha, exp);
+			return { value, value, value };
+		}
+	};
+
+	//depth buffer view, remaps the last bit of the depth range to black to white
+	class DepthProgram final : public ShaderProgram<DepthProgram>
+	{
+	public:
+		static constexpr uint32_t Varyings{ 0 };
+
+		ColorRGB PixelShader(const Vertex_Out& v, float, const ShaderResources&) const
+		{
+			//fix Z
+			//slide 22 week 8
+			const float remapDepth{ (std::clamp(v.position.z, m_MinDepth, 1.f) - m_MinDepth) / (1.f - m_MinDepth) };
+			return { remapDepth, remapDepth, remapDepth };
+		}
+
+#ifdef __AVX2__
+		Vector3x8 PixelShader8(const PixelBlock8& pixels, const ShaderResources&) const
+		{
+			const __m256 minDepth{ _mm256_set1_ps(m_MinDepth) };
+			const __m256 clampedDepth{ _mm256_min_ps(_mm256_max_ps(pixels.depth, minDepth), _mm256_set1_ps(1.f)) };
+			const __m256 remapDepth{ _mm256_div_ps(_mm256_sub_ps(clampedDepth, minDepth), _mm256_set1_ps(m_DepthRange)) };
+			return { remapDepth, remapDepth, remapDepth };
+		}
+#endif
+
+	private:
+		static constexpr float m_DepthRange{ 0.005f };
+		static constexpr float m_MinDepth{ 1.f - m_DepthRange };
+	};
+}
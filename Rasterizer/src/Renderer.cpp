@@ -4,9 +4,17 @@
 
 //Project includes
 #include "Renderer.h"
+#include "RendererSIMD.inl"
+#include "AssetLoader.h"
+#include "Materials.h"
 #include "Maths.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
 #include "Texture.h"
 #include "Utils.h"
+#include "ThreadPool.h"
+#include <cassert>
+#include <chrono>
 #include <iostream>
 
 
@@ -18,12 +26,34 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 	m_AspectRatio = (float)m_Width / (float)m_Height;
+
+	//the band has to cover the screen at least, past that the edge functions would overflow
+	assert(std::max(m_Width, m_Height) <= m_GuardBandPixels && "ERROR: window too big for the fixed point rasterizer");
+	m_GuardBand = float(m_GuardBandPixels) / float(std::max(m_Width, m_Height));
 	//Create Buffers
 	m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
 	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
 	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
 
-	m_pDepthBufferPixels = new float[m_Width * m_Height];
+	m_BufferLayout = PixelLayout{ m_Width, m_Height, m_BufferLayoutType };
+	m_pDepthBufferPixels = new float[m_BufferLayout.GetSize()];
+	m_pVisibilityBufferPixels = new uint32_t[m_BufferLayout.GetSize()];
+
+	//screen tiles for the binned final version, rounded up so the edges are covered too
+	m_TileCountX = (m_Width + m_TileSize - 1) / m_TileSize;
+	m_TileCountY = (m_Height + m_TileSize - 1) / m_TileSize;
+	m_TileBins.resize(m_TileCountX * m_TileCountY);
+
+	m_BlockCountX = (m_Width + m_BlockSize - 1) / m_BlockSize;
+	m_BlockCountY = (m_Height + m_BlockSize - 1) / m_BlockSize;
+	m_pBlockMinDepth = new float[m_BlockCountX * m_BlockCountY];
+	m_pBlockMaxDepth = new float[m_BlockCountX * m_BlockCountY];
+	m_pTileMaxDepth = new float[m_TileCountX * m_TileCountY];
+
+	m_pThreadPool = new ThreadPool{};
+
+	const ColorRGB clearColor{ 100,100,100 };
+	m_ClearColor = 0xFF000000 | (Uint32)clearColor.r | (Uint32)clearColor.g << 8 | (Uint32)clearColor.b << 16;
 
 	//Initialize Camera
 	m_Camera.Initialize(m_AspectRatio, 45.f, { .0f,.5f,-64.f });
@@ -31,21 +61,34 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	//light variabls
 	m_AmbientColor = { 0.3f, 0.3f, 0.3f };//already set to this but repeating it just for clarity
 
-	//init textures
-	m_pTexture = Texture::LoadFromFile("Resources/vehicle_diffuse.png");
-	m_pNormalMap = Texture::LoadFromFile("Resources/vehicle_normal.png");
-	m_pSpecularMap = Texture::LoadFromFile("Resources/vehicle_specular.png");
-	m_pPhongExponentMap = Texture::LoadFromFile("Resources/vehicle_gloss.png");
+	//placeholders until the loads are done, one flat texel each so the programs sample them like any other texture
+	m_pTexture = Texture::CreateSolid(0x00808080); //grey, no specular
+	m_pNormalMap = Texture::CreateSolid(0x00FF8080); //tangent space straight up, no gloss
 	InitMesh();
+
+	//init textures and mesh, one loader thread each so they decode side by side
+	m_AssetLoadStart = std::chrono::steady_clock::now();
+	m_pAssetLoader = new AssetLoader{ 3 };
+	m_PendingTexture = m_pAssetLoader->Load([]() { return Texture::LoadPacked("Resources/vehicle_diffuse.png", "Resources/vehicle_specular.png"); });
+	m_PendingNormalMap = m_pAssetLoader->Load([]() { return Texture::LoadPacked("Resources/vehicle_normal.png", "Resources/vehicle_gloss.png"); });
+	m_PendingMesh = m_pAssetLoader->Load([]() { return LoadMesh(); });
 }
 
 Renderer::~Renderer()
 {
+	//whatever the loads still running return gets deleted with the rest below
+	CollectAssets(true);
+	delete m_pAssetLoader;
+	delete m_pThreadPool;
 	delete[] m_pDepthBufferPixels;
+	delete[] m_pVisibilityBufferPixels;
+	delete[] m_pBlockMinDepth;
+	delete[] m_pBlockMaxDepth;
+	delete[] m_pTileMaxDepth;
+	delete[] m_pVertexChunkDone;
+	delete m_pMeshCache;
 	delete m_pTexture;
 	delete m_pNormalMap;
-	delete m_pSpecularMap;
-	delete m_pPhongExponentMap;
 }
 
 void Renderer::Update(Timer* pTimer)
@@ -59,6 +102,9 @@ void Renderer::Update(Timer* pTimer)
 
 void Renderer::Render()
 {
+	//between frames nothing reads the mesh or the textures
+	CollectAssets(false);
+
 	//@START
 	//Lock BackBuffer
 
@@ -293,9 +339,9 @@ void dae::Renderer::RenderTri(const Vertex& v0, const Vertex& v1, const Vertex&
 				const float interpolatedDepth = v0.position.z * weightV0 + v1.position.z * weightV1 + v2.position.z * weightV2;
 
 				//if depth is smaller than what is stored in buffer, overwrite (slide 30)
-				if (interpolatedDepth < m_pDepthBufferPixels[px * m_Height + py]) //Depth test (slide 29)
+				if (interpolatedDepth < m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)]) //Depth test (slide 29)
 				{
-					m_pDepthBufferPixels[px * m_Height + py] = interpolatedDepth; //Depth write (slide 29)
+					m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)] = interpolatedDepth; //Depth write (slide 29)
 
 					finalColor = v0.color * weightV0 + v1.color * weightV1 + v2.color * weightV2;
 
@@ -414,9 +460,9 @@ void dae::Renderer::RenderTriWithCurrTexturePtr(const Vertex& v0, const Vertex&
 
 
 				//if depth is smaller than what is stored in buffer, overwrite (slide 30)
-				if (interpolatedDepth < m_pDepthBufferPixels[px * m_Height + py])
+				if (interpolatedDepth < m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)])
 				{
-					m_pDepthBufferPixels[px * m_Height + py] = interpolatedDepth;
+					m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)] = interpolatedDepth;
 
 					//finalColor = v0.color * weightV0 + v1.color * weightV1 + v2.color * weightV2;
 
@@ -539,10 +585,10 @@ void dae::Renderer::RenderTriWeekThree(const Vertex_Out& v0, const Vertex_Out& v
 			if (zBufferValue < 0 || zBufferValue > 1) continue;
 			//if (zBufferValue < m_Camera.nearPlane || zBufferValue > m_Camera.farPlane) continue;
 			//week 8 slide 16 step 2
-			if (zBufferValue < m_pDepthBufferPixels[px * m_Height + py]) //depth read
+			if (zBufferValue < m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)]) //depth read
 			{
 				//depth write
-				m_pDepthBufferPixels[px * m_Height + py] = zBufferValue;
+				m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)] = zBufferValue;
 
 				//slide 16 week 8 step 3.1
 				const float interpolatedW = 
@@ -886,7 +932,7 @@ void dae::Renderer::WeekOneDepthBuffer()
 
 	VertexTransformationFunction(vertices_world, vertices_ss);
 	//slide 40
-	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
+	std::fill_n(m_pDepthBufferPixels, m_BufferLayout.GetSize(), FLT_MAX);
 	SDL_FillRect(m_pBackBuffer, &m_pBackBuffer->clip_rect, 100);
 
 	//slide 29
@@ -977,9 +1023,9 @@ void dae::Renderer::WeekOneDepthBuffer()
 					const float interpolatedDepth = v0.position.z * weightV0 + v1.position.z * weightV1 + v2.position.z * weightV2;
 
 					//if depth is smaller than what is stored in buffer, overwrite (slide 30)
-					if (interpolatedDepth < m_pDepthBufferPixels[px * m_Height + py]) //Depth test (slide 29)
+					if (interpolatedDepth < m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)]) //Depth test (slide 29)
 					{
-						m_pDepthBufferPixels[px * m_Height + py] = interpolatedDepth; //Depth write (slide 29)
+						m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)] = interpolatedDepth; //Depth write (slide 29)
 
 						finalColor = v0.color * weightV0 + v1.color * weightV1 + v2.color * weightV2;
 					}
@@ -987,7 +1033,7 @@ void dae::Renderer::WeekOneDepthBuffer()
 			}
 			
 			//redundant?
-			if (m_pDepthBufferPixels[px * m_Height + py] == FLT_MAX)
+			if (m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)] == FLT_MAX)
 			{
 				finalColor = ColorRGB{ clearColor / 255.f };//tip from fellow student to do this
 			}
@@ -1023,7 +1069,7 @@ void dae::Renderer::WeekOneBBX()
 
 	VertexTransformationFunction(vertices_world, vertices_ss);
 	//slide 40
-	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
+	std::fill_n(m_pDepthBufferPixels, m_BufferLayout.GetSize(), FLT_MAX);
 	SDL_FillRect(m_pBackBuffer, &m_pBackBuffer->clip_rect, 100);
 
 	//slide 29
@@ -1131,9 +1177,9 @@ void dae::Renderer::WeekOneBBX()
 					const float interpolatedDepth = v0.position.z * weightV0 + v1.position.z * weightV1 + v2.position.z * weightV2;
 
 					//if depth is smaller than what is stored in buffer, overwrite (slide 30)
-					if (interpolatedDepth < m_pDepthBufferPixels[px * m_Height + py]) //Depth test (slide 29)
+					if (interpolatedDepth < m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)]) //Depth test (slide 29)
 					{
-						m_pDepthBufferPixels[px * m_Height + py] = interpolatedDepth; //Depth write (slide 29)
+						m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)] = interpolatedDepth; //Depth write (slide 29)
 
 						finalColor = v0.color * weightV0 + v1.color * weightV1 + v2.color * weightV2;
 						
@@ -1178,7 +1224,7 @@ void dae::Renderer::WeekTwo()
 	std::vector<Mesh> meshes_ss{};
 	//convert to screen space
 	MeshTransformationFunction(meshes_world, meshes_ss);
-	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
+	std::fill_n(m_pDepthBufferPixels, m_BufferLayout.GetSize(), FLT_MAX);
 	SDL_FillRect(m_pBackBuffer, &m_pBackBuffer->clip_rect, 100);
 
 	//clear world background
@@ -1251,7 +1297,7 @@ void dae::Renderer::WeekThree()
 
 
 	//convert to screen space //week 2
-	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
+	std::fill_n(m_pDepthBufferPixels, m_BufferLayout.GetSize(), FLT_MAX);
 	SDL_FillRect(m_pBackBuffer, &m_pBackBuffer->clip_rect, 100);
 
 	ColorRGB clearColor = ColorRGB{ 100,100,100 };
@@ -1345,14 +1391,133 @@ void dae::Renderer::VertexNDCToRaster(Vertex_Out& vertex)
 
 void dae::Renderer::InitMesh()
 {
-	//Parse object to m_Mesh
-	Utils::ParseOBJ("Resources/vehicle.obj", m_Mesh.vertices, m_Mesh.indices); //W3
-
+	//nothing to draw until LoadMesh is done and SwapInMesh hands its result over
 	const Vector3 position{ Vector3{0.f, 0.f, 0.f} };
 	const Vector3 rotation{ };
 	const Vector3 scale{ Vector3{ 1.f, 1.f, 1.f } };
 	m_Mesh.worldMatrix = Matrix::CreateScale(scale) * Matrix::CreateRotation(rotation) * Matrix::CreateTranslation(position);
-	m_Mesh.primitiveTopology = PrimitiveTopology::TriangleList;
+
+	PrepareVertexChunks();
+}
+
+//what LoadMesh builds for the final version, handed over whole between two frames
+struct dae::Renderer::LoadedMesh
+{
+	~LoadedMesh() { delete pCache; }
+
+	std::vector<Vertex> vertices{};
+	std::vector<uint32_t> indices{};
+	PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleList };
+	MeshCache* pCache{}; //set when it came from the cache, vertexInput and pIndices then point into its mapping
+	VertexInStream vertexInput{};
+	VertexQuantization quantization{};
+	const uint32_t* pIndices{};
+	size_t indexCount{};
+};
+
+dae::Renderer::LoadedMesh* dae::Renderer::LoadMesh()
+{
+	const std::string sourcePath{ "Resources/vehicle.obj" }; //W3
+	const std::string cachePath{ "Resources/vehicle.mesh" };
+	const auto loadStart{ std::chrono::steady_clock::now() };
+	LoadedMesh* pLoaded{ new LoadedMesh{} };
+
+	//the cache holds the parsed and optimized mesh, the vertex stage and the binner read straight from its mapping
+	MeshCache* pCache{ new MeshCache{ cachePath, sourcePath } };
+	if (pCache->IsValid())
+	{
+		pLoaded->pCache = pCache;
+		pCache->ViewVertices(pLoaded->vertexInput);
+		pLoaded->quantization = pCache->GetQuantization();
+		pLoaded->pIndices = pCache->GetIndices();
+		pLoaded->indexCount = pCache->GetIndexCount();
+		pLoaded->primitiveTopology = pCache->GetPrimitiveTopology();
+
+		const std::chrono::duration<double, std::milli> loadTime{ std::chrono::steady_clock::now() - loadStart };
+		std::cout << "Mesh: " << pLoaded->vertexInput.GetCount() << " vertices, " << pLoaded->indexCount << " indices, mapped from "
+			<< cachePath << " in " << loadTime.count() << " ms" << std::endl;
+		return pLoaded;
+	}
+
+	//stale or missing, let go of the old mapping so the new cache can replace the file
+	delete pCache;
+
+	//Parse object to the loaded mesh
+	//on a pool of its own, parse jobs in the render pool's queue would hold up the ParallelFor of the frames drawn meanwhile
+	std::vector<Vertex>& vertices{ pLoaded->vertices };
+	std::vector<uint32_t>& indices{ pLoaded->indices };
+	{
+		ThreadPool parsePool{};
+		Utils::ParseOBJ(sourcePath, vertices, indices, true, &parsePool);
+	}
+	const std::chrono::duration<double, std::milli> parseTime{ std::chrono::steady_clock::now() - loadStart };
+
+	//triangle order for the vertex cache and for overdraw, then the vertices in the order the triangles use them
+	const float acmrBefore{ MeshOptimizer::ComputeACMR(indices, vertices.size()) };
+	MeshOptimizer::OptimizeVertexCache(indices, vertices.size());
+	const float acmrCacheOrder{ MeshOptimizer::ComputeACMR(indices, vertices.size()) };
+	MeshOptimizer::OptimizeOverdraw(indices, vertices);
+	MeshOptimizer::OptimizeVertexFetch(vertices, indices);
+	std::cout << "Mesh: " << indices.size() / 3 << " triangles, " << vertices.size() << " vertices, ACMR (FIFO 16) "
+		<< acmrBefore << " -> " << acmrCacheOrder << " -> " << MeshOptimizer::ComputeACMR(indices, vertices.size()) << " after overdraw, parsed in " << parseTime.count() << " ms" << std::endl;
+
+	//the final version's vertex stage reads this quantized structure of arrays copy, vertices stays for the week functions
+	PackVertices(vertices, pLoaded->vertexInput, pLoaded->quantization);
+	pLoaded->pIndices = indices.data();
+	pLoaded->indexCount = indices.size();
+
+	if (!MeshCache::Write(cachePath, sourcePath, pLoaded->vertexInput, pLoaded->quantization, indices, pLoaded->primitiveTopology))
+	{
+		std::cout << "Mesh: could not write " << cachePath << ", the next start parses again" << std::endl;
+	}
+	return pLoaded;
+}
+
+void dae::Renderer::SwapInMesh(LoadedMesh* pLoaded)
+{
+	//swapping keeps the vector buffers where they are, so pIndices stays valid
+	m_Mesh.vertices.swap(pLoaded->vertices);
+	m_Mesh.indices.swap(pLoaded->indices);
+	m_Mesh.primitiveTopology = pLoaded->primitiveTopology;
+	m_VertexInput.Swap(pLoaded->vertexInput);
+	m_VertexQuantization = pLoaded->quantization;
+	std::swap(m_pMeshCache, pLoaded->pCache);
+	m_pIndices = pLoaded->pIndices;
+	m_IndexCount = pLoaded->indexCount;
+
+	//the old mesh leaves with it
+	delete pLoaded;
+	PrepareVertexChunks();
+}
+
+void dae::Renderer::CollectAssets(bool wait)
+{
+	if (m_pAssetLoader == nullptr) return;
+
+	const auto isDone{ [wait](const auto& future) { return future.valid() && (wait || AssetLoader::IsReady(future)); } };
+	const auto swapInTexture{ [](Texture*& pTexture, Texture* pLoaded)
+		{
+			//a texture that failed to load keeps its placeholder
+			if (pLoaded == nullptr) return;
+			delete pTexture;
+			pTexture = pLoaded;
+		} };
+
+	const bool wasLoading{ m_PendingTexture.valid() || m_PendingNormalMap.valid() || m_PendingMesh.valid() };
+	if (isDone(m_PendingTexture)) swapInTexture(m_pTexture, m_PendingTexture.get());
+	if (isDone(m_PendingNormalMap)) swapInTexture(m_pNormalMap, m_PendingNormalMap.get());
+	if (isDone(m_PendingMesh)) SwapInMesh(m_PendingMesh.get());
+
+	if (wasLoading && !m_PendingTexture.valid() && !m_PendingNormalMap.valid() && !m_PendingMesh.valid())
+	{
+		const std::chrono::duration<double, std::milli> loadTime{ std::chrono::steady_clock::now() - m_AssetLoadStart };
+		std::cout << "Assets: all swapped in " << loadTime.count() << " ms after the renderer was created" << std::endl;
+	}
+}
+
+void dae::Renderer::WaitForAssets()
+{
+	CollectAssets(true);
 }
 
 bool dae::Renderer::isOutsideFrustum(const Vertex_Out& vertex) const
@@ -1378,306 +1543,783 @@ bool dae::Renderer::isInFrustum(const Vertex_Out& vertex) const
 	return !isOutsideFrustum(vertex);
 }
 
-void dae::Renderer::RenderTriangleFinalVersion(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2) const
+bool dae::Renderer::SetupTriangle(const Vector4& p0, const Vector4& p1, const Vector4& p2, TriangleSetup& setup) const
 {
+	//snap to the sub-pixel grid, everything after this is exact integer math
+	const int64_t x0{ std::llround(p0.x * m_SubPixelSteps) };
+	const int64_t y0{ std::llround(p0.y * m_SubPixelSteps) };
+	const int64_t x1{ std::llround(p1.x * m_SubPixelSteps) };
+	const int64_t y1{ std::llround(p1.y * m_SubPixelSteps) };
+	const int64_t x2{ std::llround(p2.x * m_SubPixelSteps) };
+	const int64_t y2{ std::llround(p2.y * m_SubPixelSteps) };
+
+	//same orientation as the old Vector2::Cross check, zero or negative area is degenerate or facing away
+	const int64_t doubleArea{ (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0) };
+	if (doubleArea <= 0) return false;
+
+	//bounding box of the pixel centers inside the triangle, clipped to the screen
+	const int64_t halfPixel{ m_SubPixelSteps / 2 };
+	const int64_t minFixedX{ std::min(x0, std::min(x1, x2)) - halfPixel };
+	const int64_t minFixedY{ std::min(y0, std::min(y1, y2)) - halfPixel };
+	const int64_t maxFixedX{ std::max(x0, std::max(x1, x2)) - halfPixel };
+	const int64_t maxFixedY{ std::max(y0, std::max(y1, y2)) - halfPixel };
+
+	setup.min.x = int(std::max<int64_t>((minFixedX + m_SubPixelSteps - 1) >> m_SubPixelBits, 0));
+	setup.min.y = int(std::max<int64_t>((minFixedY + m_SubPixelSteps - 1) >> m_SubPixelBits, 0));
+	setup.max.x = int(std::min<int64_t>(maxFixedX >> m_SubPixelBits, m_Width - 1));
+	setup.max.y = int(std::min<int64_t>(maxFixedY >> m_SubPixelBits, m_Height - 1));
+	if (setup.min.x > setup.max.x || setup.min.y > setup.max.y) return false;
+
+	const int64_t startX{ (int64_t(setup.min.x) << m_SubPixelBits) + halfPixel };
+	const int64_t startY{ (int64_t(setup.min.y) << m_SubPixelBits) + halfPixel };
+
+	const int64_t edgeVertices[3][4]{ { x1, y1, x2, y2 }, { x2, y2, x0, y0 }, { x0, y0, x1, y1 } };
+	for (int i{}; i < 3; ++i)
+	{
+		const int64_t fromX{ edgeVertices[i][0] }, fromY{ edgeVertices[i][1] };
+		const int64_t a{ fromY - edgeVertices[i][3] };
+		const int64_t b{ edgeVertices[i][2] - fromX };
+
+		//top-left fill rule, pixels exactly on a right or bottom edge belong to the neighbour
+		const bool isTopLeft{ a > 0 || (a == 0 && b > 0) };
+
+		EdgeFunction& edge{ setup.edges[i] };
+		edge.bias = isTopLeft ? 0 : -1;
+		edge.stepX = int(a << m_SubPixelBits);
+		edge.stepY = int(b << m_SubPixelBits);
+		//24.8 result, fits in an int for any triangle inside the guard band (m_GuardBandPixels)
+		edge.valueAtMin = int(a * (startX - fromX) + b * (startY - fromY)) + edge.bias;
+
+		//the edge is linear, so over a block its extremes are always at two opposite corners
+		const int blockStepX{ edge.stepX * (m_BlockSize - 1) };
+		const int blockStepY{ edge.stepY * (m_BlockSize - 1) };
+		edge.blockMaxOffset = std::max(blockStepX, 0) + std::max(blockStepY, 0);
+		edge.blockMinOffset = std::min(blockStepX, 0) + std::min(blockStepY, 0);
+	}
 
-	ColorRGB finalColor{  };
-
-	//checking if pixel is in triangle
-	//Bounding box
-	Vector2 topLeft{ std::min(v0.position.x - 1 , v1.position.x - 1), std::min(v0.position.y - 1, v1.position.y - 1) };
-	Vector2 bottomRight{ std::max(v0.position.x + 1, v1.position.x + 1), std::max(v0.position.y + 1, v1.position.y + 1) };
-
-	topLeft = Vector2{ std::min(topLeft.x - 1, v2.position.x - 1), std::min(topLeft.y - 1, v2.position.y - 1) };
-	bottomRight = Vector2{ std::max(bottomRight.x + 1, v2.position.x + 1), std::max(bottomRight.y + 1, v2.position.y + 1) };
+	//the interpolated depth always lies between the vertex depths, widened a bit for rounding
+	const float depthMargin{ 1e-6f };
+	setup.minDepth = std::min(p0.z, std::min(p1.z, p2.z)) - depthMargin;
+	setup.maxDepth = std::max(p0.z, std::max(p1.z, p2.z)) + depthMargin;
+	return true;
+}
 
-	topLeft.x = Clamp((int)topLeft.x, 0, m_Width - 1);
-	bottomRight.x = Clamp((int)bottomRight.x, 0, m_Width - 1);
-	topLeft.y = Clamp((int)topLeft.y, 0, m_Height - 1);
-	bottomRight.y = Clamp((int)bottomRight.y, 0, m_Height - 1);
+bool dae::Renderer::ClampToTile(const TriangleSetup& triangle, const Int2& tileMin, const Int2& tileMax, TriangleSetup& setup) const
+{
+	setup = triangle;
+	setup.min.x = std::max(triangle.min.x, tileMin.x);
+	setup.min.y = std::max(triangle.min.y, tileMin.y);
+	setup.max.x = std::min(triangle.max.x, tileMax.x - 1);
+	setup.max.y = std::min(triangle.max.y, tileMax.y - 1);
+	if (setup.min.x > setup.max.x || setup.min.y > setup.max.y) return false;
+
+	//only the starting pixel moves, the steps in between can pass an int before they add up
+	for (int i{}; i < 3; ++i)
+	{
+		const EdgeFunction& edge{ triangle.edges[i] };
+		setup.edges[i].valueAtMin = int(int64_t(edge.valueAtMin) + int64_t(setup.min.x - triangle.min.x) * edge.stepX + int64_t(setup.min.y - triangle.min.y) * edge.stepY);
+	}
+	return true;
+}
 
-	for (int py{ int(topLeft.y) }; py < bottomRight.y; ++py)
+void dae::Renderer::SetupAttributePlanes(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, AttributePlanes& planes) const
+{
+	//same snapped positions as the edge functions
+	const float snap{ float(m_SubPixelSteps) };
+	planes.origin = Vector2{ std::round(v0.position.x * snap) / snap, std::round(v0.position.y * snap) / snap };
+	const float dx1{ std::round(v1.position.x * snap) / snap - planes.origin.x };
+	const float dy1{ std::round(v1.position.y * snap) / snap - planes.origin.y };
+	const float dx2{ std::round(v2.position.x * snap) / snap - planes.origin.x };
+	const float dy2{ std::round(v2.position.y * snap) / snap - planes.origin.y };
+
+	//SetupTriangle rejects zero area after snapping, those planes never get evaluated
+	const float doubleArea{ dx1 * dy2 - dy1 * dx2 };
+	const float invDoubleArea{ doubleArea != 0.f ? 1.f / doubleArea : 0.f };
+
+	//the only divides left, 1/w and attribute/w once per vertex instead of once per pixel
+	float channels[3][AttributePlanes::ChannelCount]{};
+	const Vertex_Out* vertices[3]{ &v0, &v1, &v2 };
+	for (int i{}; i < 3; ++i)
 	{
-		for (int px{ int(topLeft.x) }; px < bottomRight.x; ++px)
-		{
-			const Vector2 pixelPos = Vector2{ (float)px, (float)py };
+		const Vertex_Out& vertex{ *vertices[i] };
+		const float invW{ 1.f / vertex.position.w };
+		float* pChannel{ channels[i] };
+		pChannel[AttributePlanes::InvZ] = 1.f / vertex.position.z;
+		pChannel[AttributePlanes::InvW] = invW;
+		pChannel[AttributePlanes::U] = vertex.uv.x * invW;
+		pChannel[AttributePlanes::V] = vertex.uv.y * invW;
+		pChannel[AttributePlanes::ColorR] = vertex.color.r * invW;
+		pChannel[AttributePlanes::ColorG] = vertex.color.g * invW;
+		pChannel[AttributePlanes::ColorB] = vertex.color.b * invW;
+		pChannel[AttributePlanes::NormalX] = vertex.normal.x * invW;
+		pChannel[AttributePlanes::NormalY] = vertex.normal.y * invW;
+		pChannel[AttributePlanes::NormalZ] = vertex.normal.z * invW;
+		pChannel[AttributePlanes::TangentX] = vertex.tangent.x * invW;
+		pChannel[AttributePlanes::TangentY] = vertex.tangent.y * invW;
+		pChannel[AttributePlanes::TangentZ] = vertex.tangent.z * invW;
+		pChannel[AttributePlanes::ViewX] = vertex.viewDirection.x * invW;
+		pChannel[AttributePlanes::ViewY] = vertex.viewDirection.y * invW;
+		pChannel[AttributePlanes::ViewZ] = vertex.viewDirection.z * invW;
+	}
 
-			//side A cross check
-			const Vector2 sideA = Vector2{ v1.position.x - v0.position.x,
-										   v1.position.y - v0.position.y };
+	//mip level from the ratio of uv area to screen area, ignores the perspective within the triangle
+	const float uvDoubleArea{ std::abs((v1.uv.x - v0.uv.x) * (v2.uv.y - v0.uv.y) - (v2.uv.x - v0.uv.x) * (v1.uv.y - v0.uv.y)) };
+	planes.uvLod = 0.5f * std::log2(std::max(uvDoubleArea, FLT_MIN) / std::max(std::abs(doubleArea), FLT_MIN));
 
-			const Vector2 vertex1ToPixel = Vector2{ pixelPos.x - v0.position.x,
-													pixelPos.y - v0.position.y };
+	for (int channel{}; channel < AttributePlanes::ChannelCount; ++channel)
+	{
+		const float delta1{ channels[1][channel] - channels[0][channel] };
+		const float delta2{ channels[2][channel] - channels[0][channel] };
+		planes.value[channel] = channels[0][channel];
+		planes.ddx[channel] = (delta1 * dy2 - delta2 * dy1) * invDoubleArea;
+		planes.ddy[channel] = (delta2 * dx1 - delta1 * dx2) * invDoubleArea;
+	}
+}
 
-			const float crossA{ Vector2::Cross(sideA, vertex1ToPixel) };
+template<typename Program>
+void dae::Renderer::RenderTriangleFinalVersion(const Program& program, uint32_t triangleIndex, const Int2& tileMin, const Int2& tileMax) const
+{
+	const AttributePlanes& planes{ m_BinnedPlanes[triangleIndex] };
+	const uint32_t primitiveId{ triangleIndex + 1 };
 
-			if (crossA < 0) continue;
+	TriangleSetup setup{};
+	if (!ClampToTile(m_BinnedSetups[triangleIndex], tileMin, tileMax, setup)) return;
 
-			//side B cross check
-			const Vector2 sideB = Vector2{ v2.position.x - v1.position.x,
-										   v2.position.y - v1.position.y };
+	//hierarchical z, the whole triangle is behind everything drawn in this tile so far
+	const int tileIndex{ tileMin.x / m_TileSize + (tileMin.y / m_TileSize) * m_TileCountX };
+	if (setup.minDepth > m_pTileMaxDepth[tileIndex]) return;
 
-			const Vector2 vertex2ToPixel = Vector2{ pixelPos.x - v1.position.x,
-													pixelPos.y - v1.position.y };
+#ifdef __AVX2__
+	const bool wroteDepth{ RasterizeTriangleAVX2(program, planes, setup, primitiveId) };
+#else
+	bool wroteDepth{ false };
 
-			const float crossB{ Vector2::Cross(sideB, vertex2ToPixel) };
+	const EdgeFunction& edgeA{ setup.edges[2] };
+	const EdgeFunction& edgeB{ setup.edges[0] };
+	const EdgeFunction& edgeC{ setup.edges[1] };
 
-			if (crossB < 0) continue;
+	//walk the bounding box in 8x8 blocks on the block grid
+	for (int blockY{ setup.min.y & ~(m_BlockSize - 1) }; blockY <= setup.max.y; blockY += m_BlockSize)
+	{
+		for (int blockX{ setup.min.x & ~(m_BlockSize - 1) }; blockX <= setup.max.x; blockX += m_BlockSize)
+		{
+			const int blockA{ setup.EdgeValueAt(2, blockX, blockY) };
+			const int blockB{ setup.EdgeValueAt(0, blockX, blockY) };
+			const int blockC{ setup.EdgeValueAt(1, blockX, blockY) };
 
-			//side C cross check
-			const Vector2 sideC = Vector2{ v0.position.x - v2.position.x,
-										   v0.position.y - v2.position.y };
+			//no corner of the block is inside one of the edges, so nothing in it is covered
+			if (blockA + edgeA.blockMaxOffset < 0 || blockB + edgeB.blockMaxOffset < 0 || blockC + edgeC.blockMaxOffset < 0) continue;
 
-			const Vector2 vertex3ToPixel = Vector2{ pixelPos.x - v2.position.x,
-													pixelPos.y - v2.position.y };
+			//every corner is inside all three edges, so every pixel of the block is
+			const bool isFullyCovered{ ((blockA + edgeA.blockMinOffset) | (blockB + edgeB.blockMinOffset) | (blockC + edgeC.blockMinOffset)) >= 0 };
 
-			const float crossC{ Vector2::Cross(sideC, vertex3ToPixel) };
+			//the triangle is behind every pixel stored in this block
+			const int blockIndex{ blockX / m_BlockSize + (blockY / m_BlockSize) * m_BlockCountX };
+			if (setup.minDepth > m_pBlockMaxDepth[blockIndex]) continue;
+			float minWrittenDepth{ FLT_MAX };
 
-			if (crossC < 0) continue;
+			const Int2 start{ std::max(blockX, setup.min.x), std::max(blockY, setup.min.y) };
+			const Int2 end{ std::min(blockX + m_BlockSize - 1, setup.max.x), std::min(blockY + m_BlockSize - 1, setup.max.y) };
 
-			//pixel is in triangle		
-			float weight2 = crossA;
-			float weight0 = crossB;
-			float weight1 = crossC;
+			int rowA{ setup.EdgeValueAt(2, start.x, start.y) };
+			int rowB{ setup.EdgeValueAt(0, start.x, start.y) };
+			int rowC{ setup.EdgeValueAt(1, start.x, start.y) };
 
-			const float totalWeight{ weight0 + weight1 + weight2 };
+			for (int py{ start.y }; py <= end.y; ++py, rowA += edgeA.stepY, rowB += edgeB.stepY, rowC += edgeC.stepY)
+			{
+				int crossA{ rowA };
+				int crossB{ rowB };
+				int crossC{ rowC };
 
-			weight0 /= totalWeight;
-			weight1 /= totalWeight;
-			weight2 /= totalWeight;
+				for (int px{ start.x }; px <= end.x; ++px, crossA += edgeA.stepX, crossB += edgeB.stepX, crossC += edgeC.stepX)
+				{
+					//any negative edge value sets the sign bit
+					if (!isFullyCovered && (crossA | crossB | crossC) < 0) continue;
 
-			//const float interpolatedDepth = v0.position.z * weight0 + v1.position.z * weight1 + v2.position.z * weight2; //Linear
-			const float interpolatedZDepth = 1.f /
-				(
-					(1.f / v0.position.z) * weight0 +
-					(1.f / v1.position.z) * weight1 +
-					(1.f / v2.position.z) * weight2
-					); //Quadratic-ish?
+					const Vector2 pixelPos = Vector2{ px + 0.5f, py + 0.5f };
 
-			if (interpolatedZDepth < 0 || interpolatedZDepth > 1) continue; //Interpolated depth not in [0,1] range, frustrum culling for z
+					//pixel is in triangle, only the plane equations from here on
+					const float interpolatedZDepth = 1.f / planes.Evaluate(AttributePlanes::InvZ, pixelPos); //Quadratic-ish?
 
-			if (m_pDepthBufferPixels[px * m_Height + py] < interpolatedZDepth) continue; //Depth test
+					if (interpolatedZDepth < 0 || interpolatedZDepth > 1) continue; //Interpolated depth not in [0,1] range, frustrum culling for z
 
-			m_pDepthBufferPixels[px * m_Height + py] = interpolatedZDepth; //Depth write
+					if (m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)] < interpolatedZDepth) continue; //Depth test
 
-			//const Vector2 interpolatedUV = v0.uv * weight0 + v1.uv * weight1 + v2.uv * weight2; //Linear
-			const float	interpolatedWDepth = 1.f /
-				(
-					(1.f / v0.position.w) * weight0 +
-					(1.f / v1.position.w) * weight1 +
-					(1.f / v2.position.w) * weight2
-					); //Quadratic-ish?
+					m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)] = interpolatedZDepth; //Depth write
+					minWrittenDepth = std::min(minWrittenDepth, interpolatedZDepth);
 
-			const Vector2 interpolatedUV = (((v0.uv / v0.position.w) * weight0) +
-				((v1.uv / v1.position.w) * weight1) +
-				((v2.uv / v2.position.w) * weight2))
-				* interpolatedWDepth;
+					if (m_UseVisibilityBuffer)
+					{
+						m_pVisibilityBufferPixels[m_BufferLayout.GetIndex(px, py)] = primitiveId;
+						continue;
+					}
 
-			Vertex_Out outputPixel;
-			outputPixel.position = Vector4{ pixelPos.x, pixelPos.y, interpolatedZDepth, interpolatedWDepth };
+					ColorRGB finalColor{ program.PixelShader(InterpolatePixel<Program::Varyings>(planes, pixelPos, interpolatedZDepth), planes.uvLod, m_ShaderResources) };
+					finalColor.MaxToOne();
 
-			outputPixel.uv = interpolatedUV;
+					m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
+						static_cast<uint8_t>(finalColor.r * 255),
+						static_cast<uint8_t>(finalColor.g * 255),
+						static_cast<uint8_t>(finalColor.b * 255));
+				}
+			}
 
-			outputPixel.color = (((v0.color / v0.position.w) * weight0) +
-				((v1.color / v1.position.w) * weight1) +
-				((v2.color / v2.position.w) * weight2))
-				* interpolatedWDepth;
+			if (minWrittenDepth != FLT_MAX)
+			{
+				UpdateBlockDepth(blockX, blockY, minWrittenDepth);
+				wroteDepth = true;
+			}
+		}
+	}
 
-			outputPixel.normal = ((((v0.normal / v0.position.w) * weight0) +
-				((v1.normal / v1.position.w) * weight1) +
-				((v2.normal / v2.position.w) * weight2))
-				* interpolatedWDepth).Normalized();
+#endif
 
-			outputPixel.tangent = ((((v0.tangent / v0.position.w) * weight0) +
-				((v1.tangent / v1.position.w) * weight1) +
-				((v2.tangent / v2.position.w) * weight2))
-				* interpolatedWDepth).Normalized();
+	if (wroteDepth)
+	{
+		UpdateTileDepth(tileMin, tileMax);
+	}
+}
 
-			outputPixel.viewDirection = ((((v0.viewDirection / v0.position.w) * weight0) +
-				((v1.viewDirection / v1.position.w) * weight1) +
-				((v2.viewDirection / v2.position.w) * weight2))
-				* interpolatedWDepth).Normalized();
+template<uint32_t Varyings>
+Vertex_Out dae::Renderer::InterpolatePixel(const AttributePlanes& planes, const Vector2& pixelPos, float depth) const
+{
+	//every channel is attribute / w, multiplying by the interpolated w makes it perspective correct again
+	//slots the program doesn't read are left at their defaults
+	const float dx{ pixelPos.x - planes.origin.x };
+	const float dy{ pixelPos.y - planes.origin.y };
+	auto evaluate = [&](int channel)
+		{
+			return planes.value[channel] + planes.ddx[channel] * dx + planes.ddy[channel] * dy;
+		};
+	const float interpolatedWDepth{ 1.f / evaluate(AttributePlanes::InvW) };
+	auto evaluate3 = [&](int firstChannel)
+		{
+			return Vector3{ evaluate(firstChannel), evaluate(firstChannel + 1), evaluate(firstChannel + 2) } * interpolatedWDepth;
+		};
+
+	Vertex_Out outputPixel;
+	outputPixel.position = Vector4{ pixelPos.x, pixelPos.y, depth, interpolatedWDepth };
+	if constexpr ((Varyings & varyings::UV) != 0)
+		outputPixel.uv = Vector2{ evaluate(AttributePlanes::U), evaluate(AttributePlanes::V) } * interpolatedWDepth;
+	if constexpr ((Varyings & varyings::Color) != 0)
+		outputPixel.color = ColorRGB{ evaluate(AttributePlanes::ColorR), evaluate(AttributePlanes::ColorG), evaluate(AttributePlanes::ColorB) } * interpolatedWDepth;
+	if constexpr ((Varyings & varyings::Normal) != 0)
+		outputPixel.normal = evaluate3(AttributePlanes::NormalX).Normalized();
+	if constexpr ((Varyings & varyings::Tangent) != 0)
+		outputPixel.tangent = evaluate3(AttributePlanes::TangentX).Normalized();
+	if constexpr ((Varyings & varyings::ViewDirection) != 0)
+		outputPixel.viewDirection = evaluate3(AttributePlanes::ViewX).Normalized();
+
+	return outputPixel;
+}
 
-			finalColor = PixelShading(outputPixel);
+template<typename Program>
+void dae::Renderer::ShadeVisibilityBuffer(const Program& program, const Int2& tileMin, const Int2& tileMax) const
+{
+	for (int py{ tileMin.y }; py < tileMax.y; ++py)
+	{
+		for (int px{ tileMin.x }; px < tileMax.x; ++px)
+		{
+			const uint32_t primitiveId{ m_pVisibilityBufferPixels[m_BufferLayout.GetIndex(px, py)] };
+			if (primitiveId == 0) continue;
 
+			//same plane equations as the forward path
+			const Vector2 pixelPos{ px + 0.5f, py + 0.5f };
+			const AttributePlanes& planes{ m_BinnedPlanes[primitiveId - 1] };
+			ColorRGB finalColor{ program.PixelShader(InterpolatePixel<Program::Varyings>(planes, pixelPos, m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)]), planes.uvLod, m_ShaderResources) };
 			finalColor.MaxToOne();
 
 			m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
 				static_cast<uint8_t>(finalColor.r * 255),
 				static_cast<uint8_t>(finalColor.g * 255),
 				static_cast<uint8_t>(finalColor.b * 255));
-
 		}
 	}
+}
 
+void dae::Renderer::FinalVersion() //tweaked version of week 3
+{
+	//everything the programs read, the textures and toggles can't change halfway through a frame
+	m_ShaderResources.worldMatrix = m_Mesh.worldMatrix;
+	m_ShaderResources.worldViewProjectionMatrix = m_Mesh.worldMatrix * m_Camera.viewMatrix * m_Camera.projectionMatrix;
+	m_ShaderResources.cameraOrigin = m_Camera.origin;
+	m_ShaderResources.lightDirection = m_DirectionalLight.location;
+	m_ShaderResources.pDiffuseMap = m_pTexture;
+	m_ShaderResources.pNormalMap = m_pNormalMap;
+	m_ShaderResources.textureFilter = m_TextureFilter;
+	m_ShaderResources.diffuseReflectance = m_DiffuseKD;
+	m_ShaderResources.shininess = PhongShininess;
+	m_ShaderResources.ambientColor = m_AmbientColor;
+
+	(this->*SelectPipeline())();
 }
 
-ColorRGB dae::Renderer::PixelShading(const Vertex_Out& v) const
+dae::Renderer::Pipeline dae::Renderer::SelectPipeline() const
 {
-	ColorRGB shadedColor{};
-	Vector3 normalSample{ v.normal };
+	if (m_DepthBuffer) return &Renderer::RunPipeline<DepthProgram>;
 
-	if (m_UseNormalMap)
+	uint32_t features{ m_UseNormalMap ? phong::NormalMap : 0 };
+	switch (m_ShadingMode)
 	{
-		//slide 12 week 9
-		const Vector3 binormal = Vector3::Cross(normalSample, v.tangent);
-		const Matrix tangentSpaceAxis{ v.tangent, binormal, v.normal, {0,0,0} };
-		const ColorRGB normalColor = m_pNormalMap->Sample(v.uv);
+	case ShadingMode::ObservedArea:
+		break;
+	case ShadingMode::Diffuse:
+		features |= phong::Diffuse;
+		break;
+	case ShadingMode::Specular:
+		features |= phong::Specular;
+		break;
+	case ShadingMode::Combined:
+		features |= phong::Diffuse | phong::Specular;
+		break;
+	}
 
-		//bottom slide 19, 255 division happens in Sample
-		normalSample.x = 2.f * normalColor.r - 1.f;
-		normalSample.y = 2.f * normalColor.g - 1.f;
-		normalSample.z = 2.f * normalColor.b - 1.f;
+	//indexed by the feature bits, one entry per permutation
+	static constexpr Pipeline phongPermutations[]{
+		&Renderer::RunPipeline<PhongProgram<0>>,
+		&Renderer::RunPipeline<PhongProgram<phong::NormalMap>>,
+		&Renderer::RunPipeline<PhongProgram<phong::Diffuse>>,
+		&Renderer::RunPipeline<PhongProgram<phong::Diffuse | phong::NormalMap>>,
+		&Renderer::RunPipeline<PhongProgram<phong::Specular>>,
+		&Renderer::RunPipeline<PhongProgram<phong::Specular | phong::NormalMap>>,
+		&Renderer::RunPipeline<PhongProgram<phong::Specular | phong::Diffuse>>,
+		&Renderer::RunPipeline<PhongProgram<phong::Specular | phong::Diffuse | phong::NormalMap>> };
+	return phongPermutations[features];
+}
 
-		normalSample = tangentSpaceAxis.TransformVector(normalSample);
+template<typename Program>
+void dae::Renderer::RunPipeline()
+{
+	const Program program{};
 
-		//slide 4, make sure to norm later
-		normalSample.Normalize();
+	//clearing happens per tile in RenderTile
+	m_BinnedSetups.clear();
+	m_BinnedPlanes.clear();
+	for (auto& bin : m_TileBins)
+	{
+		bin.clear();
 	}
-	//slide 6 and onwards:
-	//observed area
-	float observedArea{ std::max(Vector3::Dot(normalSample, -m_DirectionalLight.location),0.f) };//todo check if max is fine
-	observedArea = Saturate(observedArea);
 
-	//sanple diffuse
-	const ColorRGB diffuse = m_pTexture->Sample(v.uv) * m_DiffuseKD / PI;
+	//RENDER LOGIC
+	m_CullStats = CullStats{};
+	m_VisibleIndices.clear();
+	m_ClippedVertices.clear();
+	m_VertexOutput.Resize(m_VertexInput.GetCount());
+	m_VertexOutcodes.resize(m_VertexInput.GetCount());
+	for (uint32_t i{}; i < m_VertexChunkCount; ++i)
+	{
+		m_pVertexChunkDone[i].store(false, std::memory_order_relaxed);
+	}
+	m_DoneVertexChunks = 0;
+	m_BinnedTriangleChunks = 0;
 
-	//Phong
-	const float specularity = m_pSpecularMap->Sample(v.uv).r;
-	const float phongExponent = m_pPhongExponentMap->Sample(v.uv).r * PhongShininess;
+	//convert to screen space, chunk by chunk on the pool
+	//whoever finishes a chunk also culls and bins the triangles that have all their vertices now
+	m_pThreadPool->ParallelFor(m_VertexChunkCount, [this, &program](uint32_t chunkIndex)
+		{
+			RunVertexStage(program, chunkIndex);
+			m_pVertexChunkDone[chunkIndex].store(true, std::memory_order_release);
+			BinReadyTriangles();
+		});
 
-	const ColorRGB phongColor = Phong(specularity, phongExponent, -m_DirectionalLight.location, v.viewDirection, normalSample);
+	//a chunk that finished while another thread was binning left its triangles behind
+	BinReadyTriangles();
 
-	//fix Z
-	//slide 22 week 8
-	const float zDELTA{ 0.005f };
-	const float remapDepth{ Remap(v.position.z, 1.f - zDELTA, 1.f) };
-	// const Vector3 OAVector{ cosineLaw, cosineLaw, cosineLaw }; //for ease of use
+	//clipped triangles go after all the others, same order as when culling ran in one go
+	for (size_t i{}; i < m_ClippedVertices.size(); i += 3)
+	{
+		Vertex_Out v0 = m_ClippedVertices[i];
+		Vertex_Out v1 = m_ClippedVertices[i + 1];
+		Vertex_Out v2 = m_ClippedVertices[i + 2];
 
+		VertexNDCToRaster(v0);
+		VertexNDCToRaster(v1);
+		VertexNDCToRaster(v2);
 
-	if (!m_DepthBuffer)
-	switch (m_ShadingMode)
+		BinTriangle(v0, v1, v2);
+	}
+	m_CullStats.visible = static_cast<uint32_t>(m_VisibleIndices.size() / 3 + m_ClippedVertices.size() / 3);
+
+	//every tile only writes its own pixels, so the tiles need no locking
+	m_pThreadPool->ParallelFor(static_cast<uint32_t>(m_TileBins.size()), [this, &program](uint32_t tileIndex)
+		{
+			RenderTile(program, tileIndex);
+		});
+}
+
+void dae::Renderer::BinReadyTriangles()
+{
+	//one thread bins at a time, the others go back to transforming vertices instead of waiting here
+	std::unique_lock lock{ m_BinningMutex, std::try_to_lock };
+	if (!lock.owns_lock()) return;
+
+	//chunks can finish out of order, triangles only need to know how many leading ones are done
+	while (m_DoneVertexChunks < m_VertexChunkCount && m_pVertexChunkDone[m_DoneVertexChunks].load(std::memory_order_acquire))
 	{
-	case dae::Renderer::ShadingMode::ObservedArea: //observedArea
+		++m_DoneVertexChunks;
+	}
+
+	//bins stay in submission order, a triangle chunk waits for every chunk before it
+	const uint32_t triangleCount{ GetTriangleCount() };
+	while (m_BinnedTriangleChunks < m_TriangleChunkDependencies.size() && m_TriangleChunkDependencies[m_BinnedTriangleChunks] <= m_DoneVertexChunks)
 	{
-		shadedColor = { observedArea, observedArea, observedArea };
+		const uint32_t firstTriangle{ m_BinnedTriangleChunks * m_TriangleChunkSize };
+		const size_t firstVisible{ m_VisibleIndices.size() };
+		CullTriangles(firstTriangle, std::min(firstTriangle + m_TriangleChunkSize, triangleCount));
+		++m_BinnedTriangleChunks;
+
+		for (size_t i{ firstVisible }; i < m_VisibleIndices.size(); i += 3)
+		{
+			Vertex_Out v0 = LoadVertex(m_VertexOutput, m_VisibleIndices[i]);
+			Vertex_Out v1 = LoadVertex(m_VertexOutput, m_VisibleIndices[i + 1]);
+			Vertex_Out v2 = LoadVertex(m_VertexOutput, m_VisibleIndices[i + 2]);
+
+			//NDC to raster space
+			VertexNDCToRaster(v0);
+			VertexNDCToRaster(v1);
+			VertexNDCToRaster(v2);
+
+			BinTriangle(v0, v1, v2);
+		}
 	}
-		break;
-	case dae::Renderer::ShadingMode::Diffuse: //depth
-		shadedColor = diffuse * observedArea /** m_MainLight.intensity*/;
-		break;
-	case dae::Renderer::ShadingMode::Specular: //phong
-		shadedColor = phongColor * observedArea;
-		break;
-	case dae::Renderer::ShadingMode::Combined:
-		shadedColor = diffuse * observedArea /** m_MainLight.intensity*/ + phongColor * m_AmbientColor/* m_MainLight.color*/;
-		break;
-	default:
-		std::cout << "Hit a non existing shadingMode in Renderer" << std::endl;
-		break;
+}
+
+uint32_t dae::Renderer::GetTriangleCount() const
+{
+	const uint32_t indexCount{ static_cast<uint32_t>(m_IndexCount) };
+	if (m_Mesh.primitiveTopology == PrimitiveTopology::TriangleList) return indexCount / 3;
+	return indexCount > 2 ? indexCount - 2 : 0;
+}
+
+void dae::Renderer::PrepareVertexChunks()
+{
+	m_VertexChunkCount = static_cast<uint32_t>((m_VertexInput.GetCount() + m_VertexChunkSize - 1) / m_VertexChunkSize);
+	delete[] m_pVertexChunkDone;
+	m_pVertexChunkDone = new std::atomic<bool>[m_VertexChunkCount]{};
+
+	//the highest vertex a triangle chunk or any chunk before it uses, as a count of vertex chunks
+	//meshes whose indices mostly go up start binning right after the first vertex chunk
+	const uint32_t triangleCount{ GetTriangleCount() };
+	const uint32_t indicesPerTriangle{ m_Mesh.primitiveTopology == PrimitiveTopology::TriangleList ? 3u : 1u };
+	m_TriangleChunkDependencies.clear();
+	uint32_t maxIndex{ 0 };
+	for (uint32_t firstTriangle{}; firstTriangle < triangleCount; firstTriangle += m_TriangleChunkSize)
+	{
+		const uint32_t endTriangle{ std::min(firstTriangle + m_TriangleChunkSize, triangleCount) };
+		for (uint32_t i{ firstTriangle * indicesPerTriangle }; i < (endTriangle - 1) * indicesPerTriangle + 3; ++i)
+		{
+			maxIndex = std::max(maxIndex, m_pIndices[i]);
+		}
+		m_TriangleChunkDependencies.push_back(maxIndex / m_VertexChunkSize + 1);
+	}
+}
+
+uint8_t dae::Renderer::ComputeOutcode(const Vector4& position) const
+{
+	//behind the camera the perspective divide flipped x and y, only the near plane still means something
+	if (position.w <= 0.f) return m_OutcodeNear;
+
+	//position is already divided by w, so the clip planes are the unit cube with z in [0, 1]
+	uint8_t outcode{ 0 };
+	if (position.x < -1.f) outcode |= m_OutcodeLeft;
+	if (position.x > 1.f) outcode |= m_OutcodeRight;
+	if (position.y < -1.f) outcode |= m_OutcodeBottom;
+	if (position.y > 1.f) outcode |= m_OutcodeTop;
+	if (position.z < 0.f) outcode |= m_OutcodeNear;
+	if (position.z > 1.f) outcode |= m_OutcodeFar;
+	if (std::abs(position.x) > m_GuardBand || std::abs(position.y) > m_GuardBand) outcode |= m_OutcodeGuardBand;
+	return outcode;
+}
+
+void dae::Renderer::CullTriangles(uint32_t firstTriangle, uint32_t endTriangle)
+{
+	if (m_Mesh.primitiveTopology == PrimitiveTopology::TriangleList)
+	{
+		for (size_t i{ firstTriangle * size_t(3) }; i < endTriangle * size_t(3); i += 3)
+		{
+			CullTriangle(m_pIndices[i], m_pIndices[i + 1], m_pIndices[i + 2]);
+		}
 	}
 	else
 	{
-		shadedColor = { remapDepth, remapDepth, remapDepth };
+		//every odd triangle of a strip has its winding flipped
+		for (size_t i{ firstTriangle }; i < endTriangle; ++i)
+		{
+			if (i % 2 != 0) CullTriangle(m_pIndices[i], m_pIndices[i + 2], m_pIndices[i + 1]);
+			else CullTriangle(m_pIndices[i], m_pIndices[i + 1], m_pIndices[i + 2]);
+		}
+	}
+}
+
+void dae::Renderer::CullTriangle(uint32_t i0, uint32_t i1, uint32_t i2)
+{
+	++m_CullStats.triangles;
+
+	//trivial reject, all three vertices are outside the same plane
+	const uint8_t outcode0{ m_VertexOutcodes[i0] }, outcode1{ m_VertexOutcodes[i1] }, outcode2{ m_VertexOutcodes[i2] };
+	if ((outcode0 & outcode1 & outcode2) != 0)
+	{
+		++m_CullStats.outsideFrustum;
+		return;
 	}
 
+	//behind the near plane the divide is meaningless and past the guard band the edge functions overflow
+	const uint8_t outcodeUnion{ uint8_t(outcode0 | outcode1 | outcode2) };
+	if ((outcodeUnion & (m_OutcodeNear | m_OutcodeGuardBand)) != 0)
+	{
+		++m_CullStats.clipped;
+		ClipTriangle(i0, i1, i2, (outcodeUnion & m_OutcodeNear) != 0);
+		return;
+	}
 
-	return shadedColor;
+	bool isFrontFacing{};
+	if (!CullFace(LoadPosition(m_VertexOutput, i0), LoadPosition(m_VertexOutput, i1), LoadPosition(m_VertexOutput, i2), isFrontFacing)) return;
+
+	m_VisibleIndices.push_back(i0);
+	m_VisibleIndices.push_back(isFrontFacing ? i1 : i2);
+	m_VisibleIndices.push_back(isFrontFacing ? i2 : i1);
 }
 
-ColorRGB dae::Renderer::Phong(float specularity, float exp, const Vector3& l, const Vector3& v, const Vector3& n) const
+bool dae::Renderer::CullFace(const Vector4& p0, const Vector4& p1, const Vector4& p2, bool& isFrontFacing)
 {
-	const Vector3 reflection = Vector3::Reflect(l, n);
-	const float cosAlpha = std::max(0.f, Vector3::Dot(reflection, v));
-	const float value = specularity * powf(cosAlpha, exp);
-	ColorRGB phongColor{ value, value, value };
+	//signed area in raster space, y points down there so NDC y gets flipped
+	const float doubleArea{ -((p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x)) * m_Width * m_Height * 0.25f };
 
-	return phongColor;
+	if (doubleArea == 0.f)
+	{
+		++m_CullStats.degenerate;
+		return false;
+	}
+
+	//positive area faces the camera, that is the winding SetupTriangle expects
+	isFrontFacing = doubleArea > 0.f;
+	if ((m_CullMode == CullMode::Back && !isFrontFacing) || (m_CullMode == CullMode::Front && isFrontFacing))
+	{
+		++m_CullStats.culledFaces;
+		return false;
+	}
+	return true;
 }
 
-void dae::Renderer::FinalVersion() //tweaked version of week 3
+void dae::Renderer::ClipTriangle(uint32_t i0, uint32_t i1, uint32_t i2, bool crossesNear)
 {
-	std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
-	SDL_FillRect(m_pBackBuffer, &m_pBackBuffer->clip_rect, 100);
+	ClipVertex polygon[m_MaxClipVertices]{};
+	ClipVertex clipped[m_MaxClipVertices]{};
+	const uint32_t indices[3]{ i0, i1, i2 };
+	for (int i{}; i < 3; ++i)
+	{
+		polygon[i].position = LoadClipPosition(m_VertexOutput, indices[i]);
+		polygon[i].vertex = LoadVertex(m_VertexOutput, indices[i]);
+	}
+	int count{ 3 };
 
-	ColorRGB clearColor = ColorRGB{ 100,100,100 };
-	Uint32 clearColorUint = 0xFF000000 | (Uint32)clearColor.r | (Uint32)clearColor.g << 8 | (Uint32)clearColor.b << 16;
-	SDL_FillRect(m_pBackBuffer, NULL, clearColorUint);
+	//plane . position >= 0 is inside. near is z >= 0, the guard band is -g * w <= x, y <= g * w
+	const Vector4 planes[5]{
+		{ 0.f, 0.f, 1.f, 0.f },
+		{ 1.f, 0.f, 0.f, m_GuardBand },
+		{ -1.f, 0.f, 0.f, m_GuardBand },
+		{ 0.f, 1.f, 0.f, m_GuardBand },
+		{ 0.f, -1.f, 0.f, m_GuardBand } };
 
-	//RENDER LOGIC
+	for (int i{ crossesNear ? 0 : 1 }; i < 5; ++i)
+	{
+		count = ClipPolygon(polygon, count, clipped, planes[i]);
+		if (count < 3) return;
+		std::copy(clipped, clipped + count, polygon);
+	}
 
-	//convert to screen space
-	VertexTransformationFunctionImproved(m_Mesh.vertices, m_Mesh.vertices_out, m_Mesh.worldMatrix);
+	//perspective divide like RunVertexStage, w stays for the interpolation
+	for (int i{}; i < count; ++i)
+	{
+		const Vector4& position{ polygon[i].position };
+		polygon[i].vertex.position = Vector4{ position.x / position.w, position.y / position.w, position.z / position.w, position.w };
+	}
 
-	if (m_Mesh.primitiveTopology == PrimitiveTopology::TriangleList)
+	//the clipped polygon is convex, fan it out from the first vertex
+	for (int i{ 1 }; i + 1 < count; ++i)
 	{
-		for (int i{}; i < m_Mesh.indices.size() / 3; ++i)
-		{
-			Vertex_Out v0 = m_Mesh.vertices_out[m_Mesh.indices[i * 3]];
-			Vertex_Out v1 = m_Mesh.vertices_out[m_Mesh.indices[i * 3 + 1]];
-			Vertex_Out v2 = m_Mesh.vertices_out[m_Mesh.indices[i * 3 + 2]];
+		const Vertex_Out& v0{ polygon[0].vertex };
+		const Vertex_Out& v1{ polygon[i].vertex };
+		const Vertex_Out& v2{ polygon[i + 1].vertex };
 
+		bool isFrontFacing{};
+		if (!CullFace(v0.position, v1.position, v2.position, isFrontFacing)) continue;
 
-			if (isOutsideFrustum(v0)) continue;
-			if (isOutsideFrustum(v1)) continue;
-			if (isOutsideFrustum(v2)) continue;
-			
+		m_ClippedVertices.push_back(v0);
+		m_ClippedVertices.push_back(isFrontFacing ? v1 : v2);
+		m_ClippedVertices.push_back(isFrontFacing ? v2 : v1);
+	}
+}
 
-			//NDC to raster space
-			VertexNDCToRaster(v0);
-			VertexNDCToRaster(v1);
-			VertexNDCToRaster(v2);
+int dae::Renderer::ClipPolygon(const ClipVertex* pInput, int inputCount, ClipVertex* pOutput, const Vector4& plane) const
+{
+	int outputCount{ 0 };
+	for (int i{}; i < inputCount; ++i)
+	{
+		const ClipVertex& current{ pInput[i] };
+		const ClipVertex& next{ pInput[(i + 1) % inputCount] };
+		const float currentDistance{ Vector4::Dot(plane, current.position) };
+		const float nextDistance{ Vector4::Dot(plane, next.position) };
 
-			RenderTriangleFinalVersion(v0, v1, v2);
+		if (currentDistance >= 0.f) pOutput[outputCount++] = current;
+
+		//the edge crosses the plane, add the intersection. clip space is still linear so every attribute lerps
+		if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+		{
+			const float t{ currentDistance / (currentDistance - nextDistance) };
+			ClipVertex& intersection{ pOutput[outputCount++] };
+			intersection.position = current.position + (next.position - current.position) * t;
+			intersection.vertex.color = ColorRGB::Lerp(current.vertex.color, next.vertex.color, t);
+			intersection.vertex.uv = current.vertex.uv + (next.vertex.uv - current.vertex.uv) * t;
+			intersection.vertex.normal = current.vertex.normal + (next.vertex.normal - current.vertex.normal) * t;
+			intersection.vertex.tangent = current.vertex.tangent + (next.vertex.tangent - current.vertex.tangent) * t;
+			intersection.vertex.viewDirection = current.vertex.viewDirection + (next.vertex.viewDirection - current.vertex.viewDirection) * t;
 		}
 	}
-	else
+	return outputCount;
+}
+
+void dae::Renderer::ChangeCullMode()
+{
+	switch (m_CullMode)
 	{
-		for (int i{}; i < m_Mesh.indices.size() - 2; ++i)
-		{
-			if (i % 2 != 0)
-			{
-				Vertex_Out v0 = m_Mesh.vertices_out[m_Mesh.indices[i]];
-				Vertex_Out v1 = m_Mesh.vertices_out[m_Mesh.indices[i + 2]];
-				Vertex_Out v2 = m_Mesh.vertices_out[m_Mesh.indices[i + 1]];
+	case dae::Renderer::CullMode::None:
+		std::cout << "Cull mode set to Back" << std::endl;
+		m_CullMode = CullMode::Back;
+		break;
+	case dae::Renderer::CullMode::Back:
+		std::cout << "Cull mode set to Front" << std::endl;
+		m_CullMode = CullMode::Front;
+		break;
+	case dae::Renderer::CullMode::Front:
+		std::cout << "Cull mode set to None" << std::endl;
+		m_CullMode = CullMode::None;
+		break;
+	}
+}
 
+void dae::Renderer::ChangeTextureFilter()
+{
+	switch (m_TextureFilter)
+	{
+	case Texture::Filter::Point:
+		std::cout << "Texture filter set to Bilinear" << std::endl;
+		m_TextureFilter = Texture::Filter::Bilinear;
+		break;
+	case Texture::Filter::Bilinear:
+		std::cout << "Texture filter set to Trilinear" << std::endl;
+		m_TextureFilter = Texture::Filter::Trilinear;
+		break;
+	case Texture::Filter::Trilinear:
+		std::cout << "Texture filter set to Point" << std::endl;
+		m_TextureFilter = Texture::Filter::Point;
+		break;
+	}
+}
 
-				if (isOutsideFrustum(v0)) continue;
-				if (isOutsideFrustum(v1)) continue;
-				if (isOutsideFrustum(v2)) continue;
+void dae::Renderer::PrintCullStats() const
+{
+	std::cout << "triangles: " << m_CullStats.triangles
+		<< " outside frustum: " << m_CullStats.outsideFrustum
+		<< " clipped: " << m_CullStats.clipped
+		<< " degenerate: " << m_CullStats.degenerate
+		<< " culled faces: " << m_CullStats.culledFaces
+		<< " visible: " << m_CullStats.visible << std::endl;
+}
 
+void dae::Renderer::BinTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2)
+{
+	//edge functions over the whole screen, the tiles only clamp them, triangles that cover no pixel center never get binned
+	TriangleSetup setup{};
+	if (!SetupTriangle(v0.position, v1.position, v2.position, setup)) return;
 
-				//NDC to raster space
-				VertexNDCToRaster(v0);
-				VertexNDCToRaster(v1);
-				VertexNDCToRaster(v2);
+	const int firstTileX{ setup.min.x / m_TileSize };
+	const int firstTileY{ setup.min.y / m_TileSize };
+	const int lastTileX{ setup.max.x / m_TileSize };
+	const int lastTileY{ setup.max.y / m_TileSize };
 
-				RenderTriangleFinalVersion(v0, v1, v2);
-			}
-			else
-			{
-				Vertex_Out v0 = m_Mesh.vertices_out[m_Mesh.indices[i]];
-				Vertex_Out v1 = m_Mesh.vertices_out[m_Mesh.indices[i + 1]];
-				Vertex_Out v2 = m_Mesh.vertices_out[m_Mesh.indices[i + 2]];
+	const uint32_t triangleIndex{ static_cast<uint32_t>(m_BinnedPlanes.size()) };
+	m_BinnedSetups.push_back(setup);
+	SetupAttributePlanes(v0, v1, v2, m_BinnedPlanes.emplace_back());
 
+	for (int tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+	{
+		for (int tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+		{
+			m_TileBins[tileX + tileY * m_TileCountX].push_back(triangleIndex);
+		}
+	}
+}
 
-				if (isOutsideFrustum(v0)) continue;
-				if (isOutsideFrustum(v1)) continue;
-				if (isOutsideFrustum(v2)) continue;
+void dae::Renderer::UpdateBlockDepth(int blockX, int blockY, float minWrittenDepth) const
+{
+	const int blockIndex{ blockX / m_BlockSize + (blockY / m_BlockSize) * m_BlockCountX };
+	m_pBlockMinDepth[blockIndex] = std::min(m_pBlockMinDepth[blockIndex], minWrittenDepth);
+
+	//depth only ever gets closer, but the farthest pixel might not have been touched, so rescan the block
+	float maxDepth{ 0.f };
+	const int endX{ std::min(blockX + m_BlockSize, m_Width) };
+	const int endY{ std::min(blockY + m_BlockSize, m_Height) };
+	for (int py{ blockY }; py < endY; ++py)
+	{
+		for (int px{ blockX }; px < endX; ++px)
+		{
+			maxDepth = std::max(maxDepth, m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)]);
+		}
+	}
+	m_pBlockMaxDepth[blockIndex] = maxDepth;
+}
 
+void dae::Renderer::UpdateTileDepth(const Int2& tileMin, const Int2& tileMax) const
+{
+	float maxDepth{ 0.f };
+	for (int blockY{ tileMin.y / m_BlockSize }; blockY * m_BlockSize < tileMax.y; ++blockY)
+	{
+		for (int blockX{ tileMin.x / m_BlockSize }; blockX * m_BlockSize < tileMax.x; ++blockX)
+		{
+			maxDepth = std::max(maxDepth, m_pBlockMaxDepth[blockX + blockY * m_BlockCountX]);
+		}
+	}
+	m_pTileMaxDepth[tileMin.x / m_TileSize + (tileMin.y / m_TileSize) * m_TileCountX] = maxDepth;
+}
 
-				//NDC to raster space
-				VertexNDCToRaster(v0);
-				VertexNDCToRaster(v1);
-				VertexNDCToRaster(v2);
+template<typename Program>
+void dae::Renderer::RenderTile(const Program& program, uint32_t tileIndex) const
+{
+	const Int2 tileMin{ int(tileIndex % m_TileCountX) * m_TileSize, int(tileIndex / m_TileCountX) * m_TileSize };
+	const Int2 tileMax{ std::min(tileMin.x + m_TileSize, m_Width), std::min(tileMin.y + m_TileSize, m_Height) };
 
-				RenderTriangleFinalVersion(v0, v1, v2);
-			}
+	//clear this tile's part of the buffers
+	for (int py{ tileMin.y }; py < tileMax.y; ++py)
+	{
+		std::fill(m_pBackBufferPixels + tileMin.x + py * m_Width, m_pBackBufferPixels + tileMax.x + py * m_Width, m_ClearColor);
+		for (int px{ tileMin.x }; px < tileMax.x; ++px)
+		{
+			m_pDepthBufferPixels[m_BufferLayout.GetIndex(px, py)] = FLT_MAX;
+			if (m_UseVisibilityBuffer) m_pVisibilityBufferPixels[m_BufferLayout.GetIndex(px, py)] = 0;
 		}
 	}
 
+	for (int blockY{ tileMin.y / m_BlockSize }; blockY * m_BlockSize < tileMax.y; ++blockY)
+	{
+		for (int blockX{ tileMin.x / m_BlockSize }; blockX * m_BlockSize < tileMax.x; ++blockX)
+		{
+			m_pBlockMinDepth[blockX + blockY * m_BlockCountX] = FLT_MAX;
+			m_pBlockMaxDepth[blockX + blockY * m_BlockCountX] = FLT_MAX;
+		}
+	}
+	m_pTileMaxDepth[tileIndex] = FLT_MAX;
 
+	//triangles are stored in submission order, so depth ties resolve like before
+	for (const uint32_t triangleIndex : m_TileBins[tileIndex])
+	{
+		RenderTriangleFinalVersion(program, triangleIndex, tileMin, tileMax);
+	}
 
+	if (m_UseVisibilityBuffer)
+	{
+		ShadeVisibilityBuffer(program, tileMin, tileMax);
+	}
 }
 
 
@@ -1,21 +1,32 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <future>
+#include <mutex>
 #include <vector>
 
 #include "Camera.h"
 #include "DataTypes.h"
+#include "PixelLayout.h"
+#include "SIMDMath.h"
+#include "ShaderProgram.h"
+#include "Texture.h"
+#include "VertexStream.h"
 
 struct SDL_Window;
 struct SDL_Surface;
 
 namespace dae
 {
-	class Texture;
 	struct Mesh;
 	struct Vertex;
 	class Timer;
 	class Scene;
+	class ThreadPool;
+	class MeshCache;
+	class AssetLoader;
 
 	class Renderer final
 	{
@@ -46,6 +57,15 @@ namespace dae
 		void ToggleNormalMap() { m_UseNormalMap = !m_UseNormalMap; };
 		void ToggleRotation() { m_Rotate = !m_Rotate; };
 		void ToggleDepthBuffer() { m_DepthBuffer = !m_DepthBuffer; };
+		void ToggleVisibilityBuffer() { m_UseVisibilityBuffer = !m_UseVisibilityBuffer; };
+		void ChangeCullMode();
+		void ChangeTextureFilter();
+		void PrintCullStats() const;
+		void RunTextureBenchmark(); //samples one frame's uvs with every texel layout (RendererBenchmark.cpp)
+		void RunVertexBenchmark(); //times the vertex stage on its own, AoS scalar against the SoA stage
+
+		//blocks until every asset is loaded and swapped in, for whatever needs the real ones instead of the placeholders
+		void WaitForAssets();
 
 
 	private:
@@ -55,7 +75,11 @@ namespace dae
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
 
+		//depth and visibility buffer share one layout, the back buffer stays row major for SDL
+		const PixelLayout::Type m_BufferLayoutType{ PixelLayout::Type::RowMajor };
+		PixelLayout m_BufferLayout{};
 		float* m_pDepthBufferPixels{};
+		uint32_t* m_pVisibilityBufferPixels{}; //binned triangle index + 1 per pixel, 0 is empty
 
 		Camera m_Camera{};
 
@@ -76,12 +100,26 @@ namespace dae
 		//meshes:
 		Mesh m_Mesh{};
 		//Textures:
-		Texture* m_pTexture{};
-		Texture* m_pNormalMap{};
-		Texture* m_pSpecularMap{};
-		Texture* m_pPhongExponentMap{};//also called Glossiness map
+		//material maps are packed at load, specular sits in the alpha of the diffuse map and gloss in the alpha of the normal map
+		//two RGBA8 fetches per pixel instead of four, and half the texture memory
+		Texture* m_pTexture{}; //diffuse rgb, specular a
+		Texture* m_pNormalMap{}; //normal rgb, gloss (phong exponent) a
+		Texture::Filter m_TextureFilter{ Texture::Filter::Trilinear };
 		
 
+		//assets load on the loader's threads while frames draw with placeholders, Render swaps each one in once it is done
+		//time to the first frame doesn't wait for any of them, the last one shows up after the slowest load
+		struct LoadedMesh;
+		AssetLoader* m_pAssetLoader{};
+		std::future<Texture*> m_PendingTexture{};
+		std::future<Texture*> m_PendingNormalMap{};
+		std::future<LoadedMesh*> m_PendingMesh{};
+		std::chrono::steady_clock::time_point m_AssetLoadStart{};
+
+		static LoadedMesh* LoadMesh(); //on a loader thread, touches nothing of the renderer, not even its pool
+		void SwapInMesh(LoadedMesh* pLoaded);
+		void CollectAssets(bool wait); //swaps in what is done, or everything once it is done when waiting
+
 		//utility functions:
 		void RenderTri(const Vertex& v0, const Vertex& v1, const Vertex& v2) const;
 		void RenderTriWithCurrTexturePtr(const Vertex& v0, const Vertex& v1, const Vertex& v2) const;
@@ -111,21 +149,212 @@ namespace dae
 
 
 
+		//triangle setup, positions snapped to 28.4 fixed point (4 bits of sub-pixel precision)
+		//edge(x, y) = A * x + B * y + C, A and B are stored pre-multiplied to step one whole pixel
+		struct EdgeFunction
+		{
+			int stepX{};
+			int stepY{};
+			int valueAtMin{}; //value at the pixel center of (minX, minY), top-left bias already applied
+			int bias{}; //0 for top and left edges, -1 for the others so shared edges are only drawn once
+			int blockMaxOffset{}; //block origin to the corner of an 8x8 block where the edge is largest
+			int blockMinOffset{}; //block origin to the corner where it is smallest
+		};
+		struct TriangleSetup
+		{
+			EdgeFunction edges[3]{}; //edge v1->v2 (weight v0), edge v2->v0 (weight v1), edge v0->v1 (weight v2)
+			Int2 min{};
+			Int2 max{}; //inclusive
+			float minDepth{}; //nearest and farthest depth any pixel of the triangle can get
+			float maxDepth{};
+
+			int EdgeValueAt(int edgeIndex, int px, int py) const
+			{
+				const EdgeFunction& edge{ edges[edgeIndex] };
+				return edge.valueAtMin + (px - min.x) * edge.stepX + (py - min.y) * edge.stepY;
+			}
+		};
+		static constexpr int m_SubPixelBits{ 4 };
+		static constexpr int m_SubPixelSteps{ 1 << m_SubPixelBits };
+		static constexpr int m_BlockSize{ 8 }; //coarse traversal, blocks fully in or out of an edge skip the per pixel edge test
+
+		bool SetupTriangle(const Vector4& p0, const Vector4& p1, const Vector4& p2, TriangleSetup& setup) const; //once per triangle when it gets binned, min and max clipped to the screen
+		bool ClampToTile(const TriangleSetup& triangle, const Int2& tileMin, const Int2& tileMax, TriangleSetup& setup) const; //per tile, false if no pixel center of the tile is left
+
+		//attribute plane equations, set up once per triangle when it gets binned and shared by every tile it touches
+		//everything is divided by w so it is linear in screen space, value(x, y) = value + ddx * (x - origin.x) + ddy * (y - origin.y)
+		//one array per coefficient with the channels side by side, so 8 channels fit in one register
+		struct alignas(32) AttributePlanes
+		{
+			enum Channel
+			{
+				InvZ, InvW,
+				U, V,
+				ColorR, ColorG, ColorB,
+				NormalX, NormalY, NormalZ,
+				TangentX, TangentY, TangentZ,
+				ViewX, ViewY, ViewZ,
+				ChannelCount
+			};
+
+			float value[ChannelCount]{};
+			float ddx[ChannelCount]{};
+			float ddy[ChannelCount]{};
+			Vector2 origin{}; //snapped position of the first vertex
+			float uvLod{}; //log2 of the uv units one pixel covers, one mip level for the whole triangle
+
+			float Evaluate(int channel, const Vector2& pixelPos) const
+			{
+				return value[channel] + ddx[channel] * (pixelPos.x - origin.x) + ddy[channel] * (pixelPos.y - origin.y);
+			}
+		};
+		void SetupAttributePlanes(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, AttributePlanes& planes) const;
+
+		//shader programs (ShaderProgram.h), everything from the vertex stage down to the pixel shader is compiled once per program
+		//the toggles pick the program once per frame, so no pixel branches on them and no call goes through a pointer
+		using Pipeline = void (Renderer::*)();
+		Pipeline SelectPipeline() const;
+		template<typename Program>
+		void RunPipeline();
+		template<typename Program>
+		void RunVertexStage(const Program& program, uint32_t chunkIndex);
+
+		//the vertex stage runs in chunks on the pool, culling and binning start on the triangles whose vertices are all done
+		//triangles still get binned one chunk after the other in submission order, by whichever thread finished a vertex chunk
+		static constexpr uint32_t m_VertexChunkSize{ 4096 }; //a multiple of VertexInStream::BlockSize
+		static constexpr uint32_t m_TriangleChunkSize{ 2048 };
+		uint32_t m_VertexChunkCount{};
+		std::atomic<bool>* m_pVertexChunkDone{};
+		std::vector<uint32_t> m_TriangleChunkDependencies{}; //per triangle chunk, how many leading vertex chunks it needs
+		std::mutex m_BinningMutex{};
+		uint32_t m_DoneVertexChunks{}; //leading vertex chunks seen as done, only touched with m_BinningMutex held
+		uint32_t m_BinnedTriangleChunks{};
+
+		void PrepareVertexChunks(); //once per mesh
+		void BinReadyTriangles();
+		uint32_t GetTriangleCount() const;
+
+		ShaderResources m_ShaderResources{};
+		//the mesh the final version draws, either a view into the mapped mesh cache or m_Mesh converted by InitMesh
+		MeshCache* m_pMeshCache{};
+		VertexInStream m_VertexInput{}; //m_Mesh.vertices as quantized structure of arrays
+		VertexQuantization m_VertexQuantization{}; //how m_VertexInput decodes back to floats
+		const uint32_t* m_pIndices{}; //m_Mesh.indices or the cache's
+		size_t m_IndexCount{};
+		VertexOutStream m_VertexOutput{}; //clip space and divided positions, the clipper works on the first
+
 		//shading and final hand in variables
-		void RenderTriangleFinalVersion(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2) const;
+		template<typename Program>
+		void RenderTriangleFinalVersion(const Program& program, uint32_t triangleIndex, const Int2& tileMin, const Int2& tileMax) const;
+		template<uint32_t Varyings>
+		Vertex_Out InterpolatePixel(const AttributePlanes& planes, const Vector2& pixelPos, float depth) const;
+
+		//visibility buffer, the raster pass only writes depth and a primitive id, every visible pixel is shaded once afterwards
+		template<typename Program>
+		void ShadeVisibilityBuffer(const Program& program, const Int2& tileMin, const Int2& tileMax) const;
+
+#ifdef __AVX2__
+		//8 pixels of a row at once, lanes that fail a test get masked instead of skipped (RendererSIMD.inl)
+		template<typename Program>
+		bool RasterizeTriangleAVX2(const Program& program, const AttributePlanes& planes, const TriangleSetup& setup, uint32_t primitiveId) const; //true if any depth got written
+#endif
+
+		//culling stage, runs per triangle chunk between the vertex transform and binning
+		//outcodes are computed once per vertex by the vertex stage, triangles only AND/OR the three codes together
+		static constexpr uint8_t m_OutcodeLeft{ 1 << 0 };
+		static constexpr uint8_t m_OutcodeRight{ 1 << 1 };
+		static constexpr uint8_t m_OutcodeBottom{ 1 << 2 };
+		static constexpr uint8_t m_OutcodeTop{ 1 << 3 };
+		static constexpr uint8_t m_OutcodeNear{ 1 << 4 };
+		static constexpr uint8_t m_OutcodeFar{ 1 << 5 };
+		static constexpr uint8_t m_OutcodeGuardBand{ 1 << 6 }; //outside the guard band on any side
+
+		//triangles crossing the side planes are rasterized as they are, the bounding box gets clamped to the screen
+		//only past the guard band they need clipping, the 28.4 edge functions of a triangle inside it stay inside an int
+		//an edge value is at most the band's area in 1/256 pixels, so the band is a fixed span in pixels and shrinks in NDC as the window grows
+		static constexpr int m_GuardBandPixels{ 2048 }; //2048 x 2048 x 256 is 2^30, half of what an int holds
+		float m_GuardBand{}; //in NDC, m_GuardBandPixels over the longer side of the window, set by the constructor
+
+		enum class CullMode
+		{
+			None,
+			Back,
+			Front
+		};
+		CullMode m_CullMode{ CullMode::Back };
+
+		//how many triangles each test removed last frame
+		struct CullStats
+		{
+			uint32_t triangles{};
+			uint32_t outsideFrustum{}; //every vertex outside the same plane
+			uint32_t clipped{}; //crossing the near plane or the guard band, went through ClipTriangle
+			uint32_t degenerate{};
+			uint32_t culledFaces{};
+			uint32_t visible{};
+		};
+		CullStats m_CullStats{};
+
+		std::vector<uint8_t> m_VertexOutcodes{};
+		std::vector<uint32_t> m_VisibleIndices{}; //3 per surviving triangle, wound so the raster space area is positive
+		std::vector<Vertex_Out> m_ClippedVertices{}; //3 per triangle that came out of the clipper, NDC like the vertex stage output
+
+		uint8_t ComputeOutcode(const Vector4& position) const;
+#ifdef __AVX2__
+		void ComputeOutcodes8(size_t first); //ComputeOutcode for a block of the vertex stage output (RendererSIMD.cpp)
+#endif
+		void CullTriangles(uint32_t firstTriangle, uint32_t endTriangle);
+		void CullTriangle(uint32_t i0, uint32_t i1, uint32_t i2);
+		bool CullFace(const Vector4& p0, const Vector4& p1, const Vector4& p2, bool& isFrontFacing); //false if degenerate or culled
+
+		//Sutherland-Hodgman in homogeneous clip space, every plane can add one vertex to the triangle
+		struct ClipVertex
+		{
+			Vector4 position{}; //clip space, not divided by w yet
+			Vertex_Out vertex{};
+		};
+		static constexpr int m_MaxClipVertices{ 8 };
+		void ClipTriangle(uint32_t i0, uint32_t i1, uint32_t i2, bool crossesNear);
+		int ClipPolygon(const ClipVertex* pInput, int inputCount, ClipVertex* pOutput, const Vector4& plane) const;
+
+		//tile binning, every tile owns its own part of the back and depth buffer
+		void BinTriangle(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2);
+		template<typename Program>
+		void RenderTile(const Program& program, uint32_t tileIndex) const;
+
+		ThreadPool* m_pThreadPool{};
+		const int m_TileSize{ 64 };
+		int m_TileCountX{};
+		int m_TileCountY{};
+		uint32_t m_ClearColor{};
+
+		std::vector<TriangleSetup> m_BinnedSetups{}; //1 per binned triangle, clipped to the screen
+		std::vector<AttributePlanes> m_BinnedPlanes{}; //1 per binned triangle
+		std::vector<std::vector<uint32_t>> m_TileBins{}; //triangle indices per tile, in submission order
+
+		//hierarchical z, nearest and farthest stored depth per 8x8 block and farthest per tile
+		//a triangle whose nearest depth is behind the farthest stored depth can't pass a single depth test
+		float* m_pBlockMinDepth{};
+		float* m_pBlockMaxDepth{};
+		float* m_pTileMaxDepth{};
+		int m_BlockCountX{};
+		int m_BlockCountY{};
+
+		void UpdateBlockDepth(int blockX, int blockY, float minWrittenDepth) const;
+		void UpdateTileDepth(const Int2& tileMin, const Int2& tileMax) const;
 
 
 
 		bool m_UseNormalMap{ true };
 		bool m_Rotate{ true };
 		bool m_DepthBuffer{ false };
+		bool m_UseVisibilityBuffer{ false };
 		const float m_RotationSpeed{ 1.f };
 
 		
 		Light m_DirectionalLight{Vector3{.577f, -.577f, .577f}};
 		//old :Light m_MainLight{ 7.f, Vector3{.577f, -.577f, .577f}, ColorRGB{.025f, .025f, .025f} };
 
-		ColorRGB PixelShading(const Vertex_Out& v) const;
 		
 		enum class ShadingMode
 		{
@@ -141,7 +370,6 @@ namespace dae
 
 		//slide 12
 		const float PhongShininess{ 25.f };
-		ColorRGB Phong(float specularity, float exp, const Vector3& l, const Vector3& v, const Vector3& n) const;
 		void FinalVersion();
 		
 
@@ -0,0 +1,246 @@
+//External includes
+#include "SDL.h"
+#include "SDL_surface.h"
+
+//Project includes
+#include "Renderer.h"
+#include "RendererSIMD.inl"
+#include "Materials.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+using namespace dae;
+
+namespace
+{
+	//set associative cache with LRU replacement, close enough to a 32KB 8-way L1 to compare layouts
+	//counts misses on the texel addresses a sample reads, not on anything else the frame touches
+	class CacheSimulator final
+	{
+	public:
+		//true on a miss
+		bool Access(const void* pAddress)
+		{
+			const uintptr_t line{ reinterpret_cast<uintptr_t>(pAddress) / m_LineSize };
+			uintptr_t* pWays{ m_Tags[line % m_SetCount] };
+			uint32_t* pStamps{ m_Stamps[line % m_SetCount] };
+			++m_Clock;
+
+			int oldestWay{ 0 };
+			for (int way{}; way < m_WayCount; ++way)
+			{
+				if (pWays[way] == line + 1)
+				{
+					pStamps[way] = m_Clock;
+					return false;
+				}
+				if (pStamps[way] < pStamps[oldestWay]) oldestWay = way;
+			}
+
+			pWays[oldestWay] = line + 1; //0 marks an empty way
+			pStamps[oldestWay] = m_Clock;
+			return true;
+		}
+
+	private:
+		static constexpr int m_LineSize{ 64 };
+		static constexpr int m_WayCount{ 8 };
+		static constexpr int m_SetCount{ 32 * 1024 / (m_LineSize * m_WayCount) };
+
+		uintptr_t m_Tags[m_SetCount][m_WayCount]{};
+		uint32_t m_Stamps[m_SetCount][m_WayCount]{};
+		uint32_t m_Clock{};
+	};
+
+	struct TextureSample
+	{
+		Vector2 uv{};
+		float uvLod{};
+	};
+}
+
+void dae::Renderer::RunTextureBenchmark()
+{
+	WaitForAssets();
+
+	//one visibility buffer frame gives every visible pixel's uv and lod without shading anything twice
+	const bool usedVisibilityBuffer{ m_UseVisibilityBuffer };
+	m_UseVisibilityBuffer = true;
+	Render();
+	m_UseVisibilityBuffer = usedVisibilityBuffer;
+
+	//walk the pixels in the order the tiles shade them, that is the order the texture sees
+	std::vector<TextureSample> samples{};
+	for (int tileY{}; tileY < m_TileCountY; ++tileY)
+	{
+		for (int tileX{}; tileX < m_TileCountX; ++tileX)
+		{
+			const int maxX{ std::min((tileX + 1) * m_TileSize, m_Width) };
+			const int maxY{ std::min((tileY + 1) * m_TileSize, m_Height) };
+			for (int py{ tileY * m_TileSize }; py < maxY; ++py)
+			{
+				for (int px{ tileX * m_TileSize }; px < maxX; ++px)
+				{
+					const uint32_t primitiveId{ m_pVisibilityBufferPixels[m_BufferLayout.GetIndex(px, py)] };
+					if (primitiveId == 0) continue;
+
+					const AttributePlanes& planes{ m_BinnedPlanes[primitiveId - 1] };
+					const Vector2 pixelPos{ px + 0.5f, py + 0.5f };
+					const float w{ 1.f / planes.Evaluate(AttributePlanes::InvW, pixelPos) };
+					samples.push_back({ Vector2{ planes.Evaluate(AttributePlanes::U, pixelPos), planes.Evaluate(AttributePlanes::V, pixelPos) } * w, planes.uvLod });
+				}
+			}
+		}
+	}
+	if (samples.empty())
+	{
+		std::cout << "Texture benchmark: nothing visible to sample" << std::endl;
+		return;
+	}
+
+	struct LayoutCase
+	{
+		const char* name;
+		PixelLayout::Type type;
+		int tileSize;
+	};
+	const LayoutCase layouts[]{
+		{ "row major", PixelLayout::Type::RowMajor, 1 },
+		{ "tiled 4x4", PixelLayout::Type::Tiled, 4 },
+		{ "tiled 8x8", PixelLayout::Type::Tiled, 8 },
+		{ "morton", PixelLayout::Type::Morton, 1 } };
+	constexpr int repeatCount{ 10 };
+
+	std::cout << "Texture benchmark, " << samples.size() << " samples per pass, diffuse map" << std::endl;
+	for (const Texture::Filter filter : { Texture::Filter::Point, Texture::Filter::Bilinear, Texture::Filter::Trilinear })
+	{
+		const char* filterName{ filter == Texture::Filter::Point ? "point" : filter == Texture::Filter::Bilinear ? "bilinear" : "trilinear" };
+		for (const LayoutCase& layout : layouts)
+		{
+			Texture* pTexture{ Texture::LoadFromFile("Resources/vehicle_diffuse.png", layout.type, layout.tileSize) };
+			if (pTexture == nullptr) return;
+
+			//misses per sample, on a cold cache so every layout starts the same
+			CacheSimulator* pCache{ new CacheSimulator{} };
+			uint64_t missCount{ 0 };
+			for (const TextureSample& sample : samples)
+			{
+				const uint32_t* texels[8]{};
+				const int texelCount{ pTexture->GetFootprint(sample.uv, sample.uvLod, filter, texels) };
+				for (int i{}; i < texelCount; ++i)
+				{
+					if (pCache->Access(texels[i])) ++missCount;
+				}
+			}
+			delete pCache;
+
+			//real sampling time, the sum only keeps the compiler from dropping the loop
+			float sum{ 0.f };
+			const auto start{ std::chrono::steady_clock::now() };
+			for (int repeat{}; repeat < repeatCount; ++repeat)
+			{
+				for (const TextureSample& sample : samples)
+				{
+					sum += pTexture->Sample(sample.uv, sample.uvLod, filter).r;
+				}
+			}
+			const std::chrono::duration<double, std::nano> elapsed{ std::chrono::steady_clock::now() - start };
+			delete pTexture;
+			volatile float sink{ sum };
+			(void)sink;
+
+			char line[128]{};
+			std::snprintf(line, sizeof(line), "%-9s %-9s  misses/sample %6.3f  ns/sample %6.2f",
+				filterName, layout.name, double(missCount) / samples.size(), elapsed.count() / (double(samples.size()) * repeatCount));
+			std::cout << line << std::endl;
+		}
+	}
+}
+
+void dae::Renderer::RunVertexBenchmark()
+{
+	WaitForAssets();
+
+	//one frame to fill the shader resources, rasterization is left out of every timing below
+	Render();
+
+	const PhongProgram<phong::Specular | phong::Diffuse | phong::NormalMap> program{};
+	const size_t vertexCount{ m_VertexInput.GetCount() };
+	constexpr int repeatCount{ 200 };
+
+	//ns per vertex of a whole vertex stage pass
+	const auto timePass{ [vertexCount](const auto& pass)
+		{
+			const auto start{ std::chrono::steady_clock::now() };
+			for (int repeat{}; repeat < repeatCount; ++repeat)
+			{
+				pass();
+			}
+			const std::chrono::duration<double, std::nano> elapsed{ std::chrono::steady_clock::now() - start };
+			return elapsed.count() / (double(vertexCount) * repeatCount);
+		} };
+
+	//how the stage used to run, a Vertex in and a Vertex_Out out at a time
+	//m_Mesh.vertices stays empty when the mesh came from the cache, so the baseline gets its own copy
+	std::vector<Vertex> vertices(vertexCount);
+	for (size_t i{}; i < vertexCount; ++i)
+	{
+		vertices[i] = LoadVertex(m_VertexInput, m_VertexQuantization, i);
+	}
+	std::vector<Vertex_Out> verticesOut(vertexCount);
+	const double aosTime{ timePass([&]()
+		{
+			for (size_t i{}; i < vertexCount; ++i)
+			{
+				Vertex_Out output{ program.VertexShader(vertices[i], m_ShaderResources) };
+				const Vector4& position{ output.position };
+				output.position = Vector4{ position.x / position.w, position.y / position.w, position.z / position.w, position.w };
+				verticesOut[i] = output;
+			}
+		}) };
+
+	//same scalar shader on the streams, what the stage does without AVX2
+	m_VertexOutput.Resize(vertexCount);
+	const double soaTime{ timePass([&]()
+		{
+			for (size_t i{}; i < vertexCount; ++i)
+			{
+				StoreVertex(m_VertexOutput, i, program.VertexShader(LoadVertex(m_VertexInput, m_VertexQuantization, i), m_ShaderResources));
+			}
+		}) };
+
+	std::cout << "Vertex benchmark, " << vertexCount << " vertices per pass, " << VertexInLayout::ComponentCount * sizeof(VertexInLayout::Element)
+		<< " bytes in per vertex (" << sizeof(Vertex) << " as Vertex)" << std::endl;
+	char line[128]{};
+	const auto printLine{ [&line](const char* name, double nsPerVertex)
+		{
+			std::snprintf(line, sizeof(line), "%-18s ns/vertex %6.2f  Mvertices/s %7.1f", name, nsPerVertex, 1000.0 / nsPerVertex);
+			std::cout << line << std::endl;
+		} };
+	printLine("AoS scalar", aosTime);
+	printLine("SoA scalar", soaTime);
+
+	//the real stage (AVX2 when compiled in), outcodes included, chunk after chunk and then spread over the pool
+	const double stageTime{ timePass([&]()
+		{
+			for (uint32_t chunkIndex{}; chunkIndex < m_VertexChunkCount; ++chunkIndex)
+			{
+				RunVertexStage(program, chunkIndex);
+			}
+		}) };
+	printLine("stage, 1 thread", stageTime);
+
+	const double parallelStageTime{ timePass([&]()
+		{
+			m_pThreadPool->ParallelFor(m_VertexChunkCount, [&](uint32_t chunkIndex)
+				{
+					RunVertexStage(program, chunkIndex);
+				});
+		}) };
+	char name[32]{};
+	std::snprintf(name, sizeof(name), "stage, %u threads", m_pThreadPool->GetThreadCount());
+	printLine(name, parallelStageTime);
+}
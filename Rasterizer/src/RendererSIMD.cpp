@@ -0,0 +1,46 @@
+//Project includes
+#include "Renderer.h"
+
+#ifdef __AVX2__
+using namespace dae;
+
+void dae::Renderer::ComputeOutcodes8(size_t first)
+{
+	using C = VertexOutLayout;
+	const __m256 x{ _mm256_load_ps(m_VertexOutput.Get(C::PositionX) + first) };
+	const __m256 y{ _mm256_load_ps(m_VertexOutput.Get(C::PositionY) + first) };
+	const __m256 z{ _mm256_load_ps(m_VertexOutput.Get(C::PositionZ) + first) };
+	const __m256 w{ _mm256_load_ps(m_VertexOutput.Get(C::PositionW) + first) };
+
+	//every test sets its bit in the lanes it holds for, same ordered compares as ComputeOutcode so NaNs set nothing
+	const auto bit{ [](__m256 test, uint8_t code) { return _mm256_and_si256(_mm256_castps_si256(test), _mm256_set1_epi32(code)); } };
+	const __m256 one{ _mm256_set1_ps(1.f) };
+	const __m256 minusOne{ _mm256_set1_ps(-1.f) };
+	const __m256 zero{ _mm256_setzero_ps() };
+	const __m256 guardBand{ _mm256_set1_ps(m_GuardBand) };
+	const __m256 signBit{ _mm256_set1_ps(-0.f) };
+
+	__m256i outcode{ bit(_mm256_cmp_ps(x, minusOne, _CMP_LT_OQ), m_OutcodeLeft) };
+	outcode = _mm256_or_si256(outcode, bit(_mm256_cmp_ps(x, one, _CMP_GT_OQ), m_OutcodeRight));
+	outcode = _mm256_or_si256(outcode, bit(_mm256_cmp_ps(y, minusOne, _CMP_LT_OQ), m_OutcodeBottom));
+	outcode = _mm256_or_si256(outcode, bit(_mm256_cmp_ps(y, one, _CMP_GT_OQ), m_OutcodeTop));
+	outcode = _mm256_or_si256(outcode, bit(_mm256_cmp_ps(z, zero, _CMP_LT_OQ), m_OutcodeNear));
+	outcode = _mm256_or_si256(outcode, bit(_mm256_cmp_ps(z, one, _CMP_GT_OQ), m_OutcodeFar));
+	const __m256 outsideGuardBand{ _mm256_or_ps(
+		_mm256_cmp_ps(_mm256_andnot_ps(signBit, x), guardBand, _CMP_GT_OQ),
+		_mm256_cmp_ps(_mm256_andnot_ps(signBit, y), guardBand, _CMP_GT_OQ)) };
+	outcode = _mm256_or_si256(outcode, bit(outsideGuardBand, m_OutcodeGuardBand));
+
+	//behind the camera only the near plane means something
+	const __m256 isBehind{ _mm256_cmp_ps(w, zero, _CMP_LE_OQ) };
+	outcode = _mm256_blendv_epi8(outcode, _mm256_set1_epi32(m_OutcodeNear), _mm256_castps_si256(isBehind));
+
+	alignas(32) int32_t codes[8];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(codes), outcode);
+	const size_t count{ std::min(size_t(8), m_VertexOutcodes.size() - first) };
+	for (size_t lane{}; lane < count; ++lane)
+	{
+		m_VertexOutcodes[first + lane] = static_cast<uint8_t>(codes[lane]);
+	}
+}
+#endif
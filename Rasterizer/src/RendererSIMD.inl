@@ -0,0 +1,203 @@
+#pragma once
+//the stage templates every shader program gets compiled into, included by each translation unit that runs a stage
+//being in a header, any Program instantiates them where it gets used, a new material needs no edit here
+
+//Project includes
+#include "Renderer.h"
+#include "Materials.h"
+#include "Maths.h"
+#include "Texture.h"
+
+template<typename Program>
+void dae::Renderer::RunVertexStage(const Program& program, uint32_t chunkIndex)
+{
+	const size_t begin{ size_t(chunkIndex) * m_VertexChunkSize };
+	const size_t end{ std::min(begin + m_VertexChunkSize, m_VertexInput.GetCount()) };
+
+	//the store does the perspective divide and keeps the clip space position next to it
+#ifdef __AVX2__
+	//a block of 8 per iteration, the padding of the last block is transformed along and never read
+	//outcodes right after the store, while the positions are still in cache
+	for (size_t first{ begin }; first < end; first += VertexInStream::BlockSize)
+	{
+		StoreVertex8(m_VertexOutput, first, program.VertexShader8(LoadVertex8(m_VertexInput, m_VertexQuantization, first), m_ShaderResources));
+		ComputeOutcodes8(first);
+	}
+#else
+	for (size_t i{ begin }; i < end; ++i)
+	{
+		StoreVertex(m_VertexOutput, i, program.VertexShader(LoadVertex(m_VertexInput, m_VertexQuantization, i), m_ShaderResources));
+		m_VertexOutcodes[i] = ComputeOutcode(LoadPosition(m_VertexOutput, i));
+	}
+#endif
+}
+
+#ifdef __AVX2__
+template<typename Program>
+bool dae::Renderer::RasterizeTriangleAVX2(const Program& program, const AttributePlanes& planes, const TriangleSetup& setup, uint32_t primitiveId) const
+{
+	const EdgeFunction& edgeA{ setup.edges[2] };
+	const EdgeFunction& edgeB{ setup.edges[0] };
+	const EdgeFunction& edgeC{ setup.edges[1] };
+
+	//per lane offsets, lane i is pixel px + i
+	const __m256i laneIndex{ _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7) };
+	const __m256i laneStepA{ _mm256_mullo_epi32(laneIndex, _mm256_set1_epi32(edgeA.stepX)) };
+	const __m256i laneStepB{ _mm256_mullo_epi32(laneIndex, _mm256_set1_epi32(edgeB.stepX)) };
+	const __m256i laneStepC{ _mm256_mullo_epi32(laneIndex, _mm256_set1_epi32(edgeC.stepX)) };
+	const __m256i rowStepA{ _mm256_set1_epi32(edgeA.stepY) };
+	const __m256i rowStepB{ _mm256_set1_epi32(edgeB.stepY) };
+	const __m256i rowStepC{ _mm256_set1_epi32(edgeC.stepY) };
+
+	//pixel center x relative to the plane origin, per lane
+	const __m256 laneCenterX{ _mm256_add_ps(_mm256_cvtepi32_ps(laneIndex), _mm256_set1_ps(0.5f - planes.origin.x)) };
+
+	const __m256 zero{ _mm256_setzero_ps() };
+	const __m256 one{ _mm256_set1_ps(1.f) };
+	const __m256 maxColor{ _mm256_set1_ps(255.f) };
+
+	const SDL_PixelFormat* pFormat{ m_pBackBuffer->format };
+	const __m128i redShift{ _mm_cvtsi32_si128(pFormat->Rshift) };
+	const __m128i greenShift{ _mm_cvtsi32_si128(pFormat->Gshift) };
+	const __m128i blueShift{ _mm_cvtsi32_si128(pFormat->Bshift) };
+	const __m256i alphaBits{ _mm256_set1_epi32(int(pFormat->Amask)) };
+
+	bool wroteDepth{ false };
+
+	//walk the bounding box in 8x8 blocks on the block grid, one block row is exactly one register
+	for (int blockY{ setup.min.y & ~(m_BlockSize - 1) }; blockY <= setup.max.y; blockY += m_BlockSize)
+	{
+		for (int px{ setup.min.x & ~(m_BlockSize - 1) }; px <= setup.max.x; px += m_BlockSize)
+		{
+			const int blockA{ setup.EdgeValueAt(2, px, blockY) };
+			const int blockB{ setup.EdgeValueAt(0, px, blockY) };
+			const int blockC{ setup.EdgeValueAt(1, px, blockY) };
+
+			//no corner of the block is inside one of the edges, so nothing in it is covered
+			if (blockA + edgeA.blockMaxOffset < 0 || blockB + edgeB.blockMaxOffset < 0 || blockC + edgeC.blockMaxOffset < 0) continue;
+
+			//every corner is inside all three edges, so the per pixel edge test can be skipped
+			const bool isFullyCovered{ ((blockA + edgeA.blockMinOffset) | (blockB + edgeB.blockMinOffset) | (blockC + edgeC.blockMinOffset)) >= 0 };
+
+			//hierarchical z, behind every stored pixel means nothing passes, in front of all of them means everything does
+			const int blockIndex{ px / m_BlockSize + (blockY / m_BlockSize) * m_BlockCountX };
+			if (setup.minDepth > m_pBlockMaxDepth[blockIndex]) continue;
+			const bool isDepthAlwaysPassing{ setup.maxDepth < m_pBlockMinDepth[blockIndex] };
+			float minWrittenDepth{ FLT_MAX };
+
+			//the bounding box can still cut the block off, it is clipped to the tile
+			const __m256i columnMask{ _mm256_and_si256(
+				_mm256_cmpgt_epi32(_mm256_set1_epi32(setup.max.x - px + 1), laneIndex),
+				_mm256_cmpgt_epi32(laneIndex, _mm256_set1_epi32(setup.min.x - px - 1))) };
+
+			const int startY{ std::max(blockY, setup.min.y) };
+			const int endY{ std::min(blockY + m_BlockSize - 1, setup.max.y) };
+
+			__m256i crossA{ _mm256_add_epi32(_mm256_set1_epi32(setup.EdgeValueAt(2, px, startY)), laneStepA) };
+			__m256i crossB{ _mm256_add_epi32(_mm256_set1_epi32(setup.EdgeValueAt(0, px, startY)), laneStepB) };
+			__m256i crossC{ _mm256_add_epi32(_mm256_set1_epi32(setup.EdgeValueAt(1, px, startY)), laneStepC) };
+
+			for (int py{ startY }; py <= endY; ++py,
+				crossA = _mm256_add_epi32(crossA, rowStepA),
+				crossB = _mm256_add_epi32(crossB, rowStepB),
+				crossC = _mm256_add_epi32(crossC, rowStepC))
+			{
+				__m256 mask{ _mm256_castsi256_ps(columnMask) };
+				if (!isFullyCovered)
+				{
+					//coverage, any negative edge value sets the sign bit
+					const __m256i edgeSigns{ _mm256_or_si256(crossA, _mm256_or_si256(crossB, crossC)) };
+					mask = _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_srai_epi32(edgeSigns, 31)), mask);
+					if (_mm256_testz_ps(mask, mask)) continue;
+				}
+
+				//plane equations, dx per lane and dy for the whole row
+				const __m256 dx{ _mm256_add_ps(laneCenterX, _mm256_set1_ps(float(px))) };
+				const __m256 dy{ _mm256_set1_ps(py + 0.5f - planes.origin.y) };
+				auto evaluate = [&](int channel)
+					{
+						return _mm256_fmadd_ps(_mm256_set1_ps(planes.ddx[channel]), dx,
+							_mm256_fmadd_ps(_mm256_set1_ps(planes.ddy[channel]), dy, _mm256_set1_ps(planes.value[channel])));
+					};
+
+				const __m256 interpolatedZDepth{ _mm256_div_ps(one, evaluate(AttributePlanes::InvZ)) };
+
+				//frustum culling for z and the depth test, both just narrow the mask
+				mask = _mm256_and_ps(mask, _mm256_cmp_ps(interpolatedZDepth, zero, _CMP_GE_OQ));
+				mask = _mm256_and_ps(mask, _mm256_cmp_ps(interpolatedZDepth, one, _CMP_LE_OQ));
+
+				//the 8 pixels of a block row are next to each other in both buffer layouts
+				const int bufferIndex{ m_BufferLayout.GetIndex(px, py) };
+				if (!isDepthAlwaysPassing)
+				{
+					const __m256 storedDepth{ _mm256_maskload_ps(m_pDepthBufferPixels + bufferIndex, _mm256_castps_si256(mask)) };
+					mask = _mm256_and_ps(mask, _mm256_cmp_ps(interpolatedZDepth, storedDepth, _CMP_LE_OQ));
+				}
+
+				const int laneMask{ _mm256_movemask_ps(mask) };
+				if (laneMask == 0) continue;
+
+				_mm256_maskstore_ps(m_pDepthBufferPixels + bufferIndex, _mm256_castps_si256(mask), interpolatedZDepth);
+				minWrittenDepth = std::min(minWrittenDepth, HorizontalMin(_mm256_blendv_ps(_mm256_set1_ps(FLT_MAX), interpolatedZDepth, mask)));
+
+				if (m_UseVisibilityBuffer)
+				{
+					_mm256_maskstore_epi32(reinterpret_cast<int*>(m_pVisibilityBufferPixels + bufferIndex), _mm256_castps_si256(mask), _mm256_set1_epi32(int(primitiveId)));
+					continue;
+				}
+
+				//every channel is attribute / w, multiplying by the interpolated w makes it perspective correct again
+				const __m256 interpolatedWDepth{ _mm256_div_ps(one, evaluate(AttributePlanes::InvW)) };
+				auto evaluate3 = [&](int firstChannel)
+					{
+						return Vector3x8{ evaluate(firstChannel), evaluate(firstChannel + 1), evaluate(firstChannel + 2) } * interpolatedWDepth;
+					};
+
+				//only the slots this program reads
+				constexpr uint32_t usedVaryings{ Program::Varyings };
+				PixelBlock8 pixels{};
+				pixels.px = px;
+				pixels.py = py;
+				pixels.laneMask = laneMask;
+				pixels.depth = interpolatedZDepth;
+				pixels.w = interpolatedWDepth;
+				pixels.uvLod = planes.uvLod;
+				if constexpr ((usedVaryings & varyings::UV) != 0)
+				{
+					pixels.u = _mm256_mul_ps(evaluate(AttributePlanes::U), interpolatedWDepth);
+					pixels.v = _mm256_mul_ps(evaluate(AttributePlanes::V), interpolatedWDepth);
+				}
+				if constexpr ((usedVaryings & varyings::Color) != 0) pixels.color = evaluate3(AttributePlanes::ColorR);
+				if constexpr ((usedVaryings & varyings::Normal) != 0) pixels.normal = evaluate3(AttributePlanes::NormalX).Normalized();
+				if constexpr ((usedVaryings & varyings::Tangent) != 0) pixels.tangent = evaluate3(AttributePlanes::TangentX).Normalized();
+				if constexpr ((usedVaryings & varyings::ViewDirection) != 0) pixels.viewDirection = evaluate3(AttributePlanes::ViewX).Normalized();
+
+				Vector3x8 finalColor{ program.PixelShader8(pixels, m_ShaderResources) };
+
+				//MaxToOne
+				const __m256 maxValue{ _mm256_max_ps(finalColor.x, _mm256_max_ps(finalColor.y, finalColor.z)) };
+				const __m256 scale{ _mm256_blendv_ps(one, _mm256_div_ps(one, maxValue), _mm256_cmp_ps(maxValue, one, _CMP_GT_OQ)) };
+				finalColor = finalColor * scale;
+
+				//same packing as SDL_MapRGB, truncating like the static_cast<uint8_t> in the scalar version
+				const __m256i red{ _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_max_ps(finalColor.x, zero), maxColor)) };
+				const __m256i green{ _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_max_ps(finalColor.y, zero), maxColor)) };
+				const __m256i blue{ _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_max_ps(finalColor.z, zero), maxColor)) };
+				const __m256i packed{ _mm256_or_si256(
+					_mm256_or_si256(_mm256_sll_epi32(red, redShift), _mm256_sll_epi32(green, greenShift)),
+					_mm256_or_si256(_mm256_sll_epi32(blue, blueShift), alphaBits)) };
+
+				_mm256_maskstore_epi32(reinterpret_cast<int*>(m_pBackBufferPixels + px + (py * m_Width)), _mm256_castps_si256(mask), packed);
+			}
+
+			if (minWrittenDepth != FLT_MAX)
+			{
+				UpdateBlockDepth(px, blockY, minWrittenDepth);
+				wroteDepth = true;
+			}
+		}
+	}
+
+	return wroteDepth;
+}
+#endif
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include "DataTypes.h"
+#include "SIMDMath.h"
+#include "Texture.h"
+#include "VertexStream.h"
+
+namespace dae
+{
+	//everything a shader program can read besides its own inputs, filled in by the renderer once per frame
+	struct ShaderResources
+	{
+		Matrix worldMatrix{};
+		Matrix worldViewProjectionMatrix{};
+		Vector3 cameraOrigin{};
+		Vector3 lightDirection{}; //the direction the light travels in
+
+		const Texture* pDiffuseMap{}; //specular in alpha
+		const Texture* pNormalMap{}; //gloss in alpha
+		Texture::Filter textureFilter{};
+
+		float diffuseReflectance{};
+		float shininess{};
+		ColorRGB ambientColor{};
+	};
+
+	//the varying slots of Vertex_Out. A program writes them in its vertex shader and reads them in its pixel shader
+	//what goes in a slot is up to the program, only the slots in Program::Varyings get interpolated per pixel
+	namespace varyings
+	{
+		constexpr uint32_t Color{ 1 << 0 };
+		constexpr uint32_t UV{ 1 << 1 };
+		constexpr uint32_t Normal{ 1 << 2 };
+		constexpr uint32_t Tangent{ 1 << 3 };
+		constexpr uint32_t ViewDirection{ 1 << 4 };
+		constexpr uint32_t All{ Color | UV | Normal | Tangent | ViewDirection };
+	}
+
+#ifdef __AVX2__
+	//8 pixels of a row for the AVX2 pixel shaders, lanes that failed a test are masked instead of skipped
+	//slots outside Program::Varyings are left at zero
+	struct PixelBlock8
+	{
+		int px{}; //pixel of lane 0, lane i is px + i
+		int py{};
+		__m256 depth{};
+		__m256 w{};
+		float uvLod{};
+		Vector3x8 color{};
+		__m256 u{};
+		__m256 v{};
+		Vector3x8 normal{};
+		Vector3x8 tangent{};
+		Vector3x8 viewDirection{};
+		int laneMask{}; //bit per lane that is still alive
+	};
+#endif
+
+	//base of every shader program, the pipeline is templated on the program so each call is resolved at compile time
+	//a program derives as class MyProgram : public ShaderProgram<MyProgram> and provides
+	//	Varyings, the slots its pixel shader reads
+	//	ColorRGB PixelShader(const Vertex_Out& pixel, float uvLod, const ShaderResources&) const
+	//and optionally hides the defaults below with its own VertexShader, VertexShader8 and PixelShader8
+	//pixel.position is the pixel center, depth and w, the other slots are already perspective correct
+	template<typename Program>
+	class ShaderProgram
+	{
+	public:
+		static constexpr uint32_t Varyings{ varyings::All };
+
+		//the standard transform, position in clip space, the pipeline does the perspective divide
+		Vertex_Out VertexShader(const Vertex& vertex, const ShaderResources& resources) const
+		{
+			Vertex_Out output{};
+			output.position = resources.worldViewProjectionMatrix.TransformPoint(Vector4{ vertex.position, 1 });
+			output.color = vertex.color;
+			output.uv = vertex.uv;
+			output.normal = resources.worldMatrix.TransformVector(vertex.normal).Normalized(); //Normal and tangent in world space
+			output.tangent = resources.worldMatrix.TransformVector(vertex.tangent).Normalized();
+			output.viewDirection = (resources.worldMatrix.TransformPoint(vertex.position) - resources.cameraOrigin).Normalized();
+			return output;
+		}
+
+#ifdef __AVX2__
+		//the standard transform for a block of 8 vertices, the AVX2 vertex stage calls this
+		//a program that only hides VertexShader still gets its own transform, run once per lane
+		VertexOut8 VertexShader8(const Vertex8& vertices, const ShaderResources& resources) const
+		{
+			if constexpr (std::is_same_v<decltype(&Program::VertexShader), decltype(&ShaderProgram::VertexShader)>)
+			{
+				VertexOut8 output{};
+				output.position = ProjectPoint8(resources.worldViewProjectionMatrix, vertices.position);
+				output.color = vertices.color;
+				output.u = vertices.u;
+				output.v = vertices.v;
+				output.normal = TransformVector8(resources.worldMatrix, vertices.normal).Normalized();
+				output.tangent = TransformVector8(resources.worldMatrix, vertices.tangent).Normalized();
+				output.viewDirection = (TransformPoint8(resources.worldMatrix, vertices.position) - Vector3x8{ resources.cameraOrigin }).Normalized();
+				return output;
+			}
+			else
+			{
+				alignas(32) float inLanes[14][8];
+				const __m256 inSlots[14]{
+					vertices.position.x, vertices.position.y, vertices.position.z,
+					vertices.color.x, vertices.color.y, vertices.color.z,
+					vertices.u, vertices.v,
+					vertices.normal.x, vertices.normal.y, vertices.normal.z,
+					vertices.tangent.x, vertices.tangent.y, vertices.tangent.z };
+				for (int i{}; i < 14; ++i) _mm256_store_ps(inLanes[i], inSlots[i]);
+
+				alignas(32) float outLanes[18][8];
+				for (int lane{}; lane < 8; ++lane)
+				{
+					Vertex vertex{};
+					vertex.position = Vector3{ inLanes[0][lane], inLanes[1][lane], inLanes[2][lane] };
+					vertex.color = ColorRGB{ inLanes[3][lane], inLanes[4][lane], inLanes[5][lane] };
+					vertex.uv = Vector2{ inLanes[6][lane], inLanes[7][lane] };
+					vertex.normal = Vector3{ inLanes[8][lane], inLanes[9][lane], inLanes[10][lane] };
+					vertex.tangent = Vector3{ inLanes[11][lane], inLanes[12][lane], inLanes[13][lane] };
+
+					const Vertex_Out out{ static_cast<const Program&>(*this).VertexShader(vertex, resources) };
+					const float outSlots[18]{
+						out.position.x, out.position.y, out.position.z, out.position.w,
+						out.color.r, out.color.g, out.color.b,
+						out.uv.x, out.uv.y,
+						out.normal.x, out.normal.y, out.normal.z,
+						out.tangent.x, out.tangent.y, out.tangent.z,
+						out.viewDirection.x, out.viewDirection.y, out.viewDirection.z };
+					for (int i{}; i < 18; ++i) outLanes[i][lane] = outSlots[i];
+				}
+
+				const auto load{ [&outLanes](int i) { return _mm256_load_ps(outLanes[i]); } };
+				VertexOut8 output{};
+				output.position = { load(0), load(1), load(2), load(3) };
+				output.color = { load(4), load(5), load(6) };
+				output.u = load(7);
+				output.v = load(8);
+				output.normal = { load(9), load(10), load(11) };
+				output.tangent = { load(12), load(13), load(14) };
+				output.viewDirection = { load(15), load(16), load(17) };
+				return output;
+			}
+		}
+
+		//programs without an 8 wide pixel shader still run on the AVX2 path, the scalar one goes over the live lanes
+		Vector3x8 PixelShader8(const PixelBlock8& pixels, const ShaderResources& resources) const
+		{
+			alignas(32) float lanes[16][8];
+			const __m256 slots[16]{
+				pixels.depth, pixels.w,
+				pixels.color.x, pixels.color.y, pixels.color.z,
+				pixels.u, pixels.v,
+				pixels.normal.x, pixels.normal.y, pixels.normal.z,
+				pixels.tangent.x, pixels.tangent.y, pixels.tangent.z,
+				pixels.viewDirection.x, pixels.viewDirection.y, pixels.viewDirection.z };
+			for (int i{}; i < 16; ++i) _mm256_store_ps(lanes[i], slots[i]);
+
+			alignas(32) float colors[3][8]{};
+			for (int lane{}; lane < 8; ++lane)
+			{
+				if ((pixels.laneMask & (1 << lane)) == 0) continue;
+
+				Vertex_Out pixel{};
+				pixel.position = Vector4{ pixels.px + lane + 0.5f, pixels.py + 0.5f, lanes[0][lane], lanes[1][lane] };
+				pixel.color = ColorRGB{ lanes[2][lane], lanes[3][lane], lanes[4][lane] };
+				pixel.uv = Vector2{ lanes[5][lane], lanes[6][lane] };
+				pixel.normal = Vector3{ lanes[7][lane], lanes[8][lane], lanes[9][lane] };
+				pixel.tangent = Vector3{ lanes[10][lane], lanes[11][lane], lanes[12][lane] };
+				pixel.viewDirection = Vector3{ lanes[13][lane], lanes[14][lane], lanes[15][lane] };
+
+				const ColorRGB color{ static_cast<const Program&>(*this).PixelShader(pixel, pixels.uvLod, resources) };
+				colors[0][lane] = color.r;
+				colors[1][lane] = color.g;
+				colors[2][lane] = color.b;
+			}
+			return { _mm256_load_ps(colors[0]), _mm256_load_ps(colors[1]), _mm256_load_ps(colors[2]) };
+		}
+#endif
+	};
+}
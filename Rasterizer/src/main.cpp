@@ -89,6 +89,26 @@ int main(int argc, char* args[])
 					//std::cout << "F7 pressed" << std::endl;
 					pRenderer->ChangeRenderMode();
 				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+				{
+					pRenderer->ToggleVisibilityBuffer();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+				{
+					pRenderer->ChangeCullMode();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+				{
+					pRenderer->ChangeTextureFilter();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+				{
+					pRenderer->RunTextureBenchmark();
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+				{
+					pRenderer->RunVertexBenchmark();
+				}
 				break;
 			}
 		}
@@ -106,6 +126,7 @@ int main(int argc, char* args[])
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			pRenderer->PrintCullStats();
 		}
 
 		//Save screenshot after full render
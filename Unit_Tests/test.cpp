@@ -1,5 +1,16 @@
 #include "gtest/gtest.h"
 #include "Maths.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+#include "VertexStream.h"
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
 
 
 namespace dae
@@ -9,4 +20,416 @@ namespace dae
 		EXPECT_TRUE(true);
 	}
 
+	namespace
+	{
+		//a vertex per direction, the tangent gets the same direction so both octahedral pairs are covered
+		std::vector<Vertex> MakeDirectionVertices(const std::vector<Vector3>& directions)
+		{
+			std::vector<Vertex> vertices{};
+			for (size_t i{}; i < directions.size(); ++i)
+			{
+				Vertex vertex{};
+				vertex.position = Vector3{ float(i) * 0.37f - 3.f, std::sin(float(i)) * 5.f, float(i % 7) * 1.9f };
+				vertex.color = ColorRGB{ float(i % 3) * 0.5f, 1.f, float(i % 5) * 0.25f };
+				vertex.uv = Vector2{ float(i % 11) * 0.09f, 1.f - float(i % 13) * 0.07f };
+				vertex.normal = directions[i];
+				vertex.tangent = directions[i];
+				vertices.push_back(vertex);
+			}
+			return vertices;
+		}
+
+		std::vector<Vector3> MakeTestDirections()
+		{
+			std::vector<Vector3> directions{ Vector3::UnitX, -Vector3::UnitX, Vector3::UnitY, -Vector3::UnitY, Vector3::UnitZ, -Vector3::UnitZ };
+			//diagonals, the octahedron's faces and edges, half of them with a negative z that goes through the fold
+			for (int x{ -1 }; x <= 1; x += 2)
+			{
+				for (int y{ -1 }; y <= 1; y += 2)
+				{
+					for (int z{ -1 }; z <= 1; ++z)
+					{
+						directions.push_back(Vector3{ float(x), float(y), float(z) }.Normalized());
+					}
+				}
+			}
+			//and a spread of directions close to the -z pole and around the equator
+			for (int i{}; i < 64; ++i)
+			{
+				const float angle{ float(i) * 0.41f };
+				directions.push_back(Vector3{ std::cos(angle) * 0.05f, std::sin(angle) * 0.05f, -1.f }.Normalized());
+				directions.push_back(Vector3{ std::cos(angle), std::sin(angle), float(i % 3 - 1) * 0.001f }.Normalized());
+			}
+			return directions;
+		}
+	}
+
+	TEST(VertexQuantization, OctahedralRoundTrip)
+	{
+		const std::vector<Vector3> directions{ MakeTestDirections() };
+		const std::vector<Vertex> vertices{ MakeDirectionVertices(directions) };
+		VertexInStream stream{};
+		VertexQuantization quantization{};
+		PackVertices(vertices, stream, quantization);
+
+		ASSERT_EQ(stream.GetCount(), vertices.size());
+		for (size_t i{}; i < vertices.size(); ++i)
+		{
+			const Vertex decoded{ LoadVertex(stream, quantization, i) };
+			EXPECT_GE(Vector3::Dot(decoded.normal, directions[i]), 0.9999f) << "direction " << i;
+			EXPECT_GE(Vector3::Dot(decoded.tangent, directions[i]), 0.9999f) << "direction " << i;
+			EXPECT_NEAR(decoded.normal.Magnitude(), 1.f, 1e-5f);
+		}
+	}
+
+	TEST(VertexQuantization, PlainComponentsWithinHalfAStep)
+	{
+		const std::vector<Vertex> vertices{ MakeDirectionVertices(MakeTestDirections()) };
+		VertexInStream stream{};
+		VertexQuantization quantization{};
+		PackVertices(vertices, stream, quantization);
+
+		//the step of a component is its scale, rounding is off by half of it at most (plus float slack)
+		const auto bound{ [&quantization](int component) { return quantization.scale[component] * 0.5f + 1e-6f; } };
+		using C = VertexInLayout;
+		for (size_t i{}; i < vertices.size(); ++i)
+		{
+			const Vertex decoded{ LoadVertex(stream, quantization, i) };
+			EXPECT_NEAR(decoded.position.x, vertices[i].position.x, bound(C::PositionX));
+			EXPECT_NEAR(decoded.position.y, vertices[i].position.y, bound(C::PositionY));
+			EXPECT_NEAR(decoded.position.z, vertices[i].position.z, bound(C::PositionZ));
+			EXPECT_NEAR(decoded.uv.x, vertices[i].uv.x, bound(C::U));
+			EXPECT_NEAR(decoded.uv.y, vertices[i].uv.y, bound(C::V));
+			//green never changes, a constant component comes back exactly
+			EXPECT_EQ(decoded.color.g, 1.f);
+		}
+	}
+
+	TEST(VertexQuantization, UnusableDirectionsComeBackAsUnitVectors)
+	{
+		const float nan{ std::numeric_limits<float>::quiet_NaN() };
+		const Vector3 unusable[]{ Vector3::Zero, Vector3{ nan, nan, nan }, Vector3{ 0.f, nan, 1.f } };
+
+		std::vector<Vertex> vertices{};
+		for (const Vector3& direction : unusable)
+		{
+			Vertex vertex{};
+			vertex.normal = direction;
+			vertex.tangent = Vector3::UnitX;
+			vertices.push_back(vertex);
+
+			vertex.normal = Vector3{ 0.f, 0.6f, 0.8f };
+			vertex.tangent = direction;
+			vertices.push_back(vertex);
+
+			vertex.normal = direction;
+			vertex.tangent = direction;
+			vertices.push_back(vertex);
+		}
+
+		VertexInStream stream{};
+		VertexQuantization quantization{};
+		PackVertices(vertices, stream, quantization);
+
+		for (size_t i{}; i < vertices.size(); ++i)
+		{
+			const Vertex decoded{ LoadVertex(stream, quantization, i) };
+			EXPECT_NEAR(decoded.normal.Magnitude(), 1.f, 1e-5f) << "vertex " << i;
+			EXPECT_NEAR(decoded.tangent.Magnitude(), 1.f, 1e-5f) << "vertex " << i;
+
+			//a replaced tangent is made perpendicular to the normal
+			if (!std::isfinite(vertices[i].tangent.SqrMagnitude()) || vertices[i].tangent.SqrMagnitude() == 0.f)
+			{
+				EXPECT_NEAR(Vector3::Dot(decoded.normal, decoded.tangent), 0.f, 1e-3f) << "vertex " << i;
+			}
+		}
+	}
+
+#ifdef __AVX2__
+	TEST(VertexQuantization, LoadVertex8MatchesLoadVertex)
+	{
+		//not a multiple of the block size, so the last block has padding lanes
+		const std::vector<Vertex> vertices{ MakeDirectionVertices(MakeTestDirections()) };
+		ASSERT_NE(vertices.size() % VertexInStream::BlockSize, 0u);
+		VertexInStream stream{};
+		VertexQuantization quantization{};
+		PackVertices(vertices, stream, quantization);
+
+		const auto lanes{ [](__m256 v, float out[8]) { _mm256_storeu_ps(out, v); } };
+		for (size_t first{}; first < vertices.size(); first += VertexInStream::BlockSize)
+		{
+			const Vertex8 block{ LoadVertex8(stream, quantization, first) };
+			const __m256 components[]{
+				block.position.x, block.position.y, block.position.z,
+				block.color.x, block.color.y, block.color.z,
+				block.u, block.v,
+				block.normal.x, block.normal.y, block.normal.z,
+				block.tangent.x, block.tangent.y, block.tangent.z };
+
+			for (int component{}; component < int(std::size(components)); ++component)
+			{
+				float values[8]{};
+				lanes(components[component], values);
+				for (size_t lane{}; lane < VertexInStream::BlockSize && first + lane < vertices.size(); ++lane)
+				{
+					const Vertex scalar{ LoadVertex(stream, quantization, first + lane) };
+					const float expected[]{
+						scalar.position.x, scalar.position.y, scalar.position.z,
+						scalar.color.r, scalar.color.g, scalar.color.b,
+						scalar.uv.x, scalar.uv.y,
+						scalar.normal.x, scalar.normal.y, scalar.normal.z,
+						scalar.tangent.x, scalar.tangent.y, scalar.tangent.z };
+					EXPECT_FLOAT_EQ(values[lane], expected[component]) << "vertex " << first + lane << " component " << component;
+				}
+			}
+		}
+	}
+#endif
+
+	namespace
+	{
+		//ParseOBJ and MeshCache map files, so every test writes its own next to the other temporaries and removes it again
+		class TempFile final
+		{
+		public:
+			TempFile(const std::string& name, const std::string& contents) :
+				m_Path{ (std::filesystem::temp_directory_path() / name).string() }
+			{
+				std::ofstream file{ m_Path, std::ios::binary | std::ios::trunc };
+				file << contents;
+			}
+			~TempFile()
+			{
+				std::error_code error{};
+				std::filesystem::remove(m_Path, error);
+			}
+
+			TempFile(const TempFile&) = delete;
+			TempFile(TempFile&&) noexcept = delete;
+			TempFile& operator=(const TempFile&) = delete;
+			TempFile& operator=(TempFile&&) noexcept = delete;
+
+			const std::string& GetPath() const { return m_Path; }
+
+		private:
+			std::string m_Path;
+		};
+
+		bool IsUnitAndFinite(const Vector3& v)
+		{
+			return std::isfinite(v.SqrMagnitude()) && std::abs(v.Magnitude() - 1.f) < 1e-5f;
+		}
+
+		//exact, the vectors' own operator== allows for an epsilon
+		bool IsSame(const Vector3& a, const Vector3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+		bool IsSame(const Vector2& a, const Vector2& b) { return a.x == b.x && a.y == b.y; }
+	}
+
+	TEST(ParseOBJ, SharedCornersAreMerged)
+	{
+		//a quad as two triangles, the diagonal's two corners are used by both
+		const TempFile obj{ "dae_test_shared.obj",
+			"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+			"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+			"vn 0 0 1\n"
+			"f 1/1/1 2/2/1 3/3/1\nf 1/1/1 3/3/1 4/4/1\n" };
+
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		ASSERT_TRUE(Utils::ParseOBJ(obj.GetPath(), vertices, indices, false));
+		ASSERT_EQ(vertices.size(), 4u);
+		const std::vector<uint32_t> expected{ 0, 1, 2, 0, 2, 3 };
+		EXPECT_EQ(indices, expected);
+		EXPECT_TRUE(IsSame(vertices[2].position, Vector3{ 1.f, 1.f, 0.f }));
+	}
+
+	TEST(ParseOBJ, SamePositionWithOtherUvStaysSplit)
+	{
+		//a uv seam, both triangles use positions 1 and 3 but with uvs of their own
+		const TempFile obj{ "dae_test_seam.obj",
+			"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+			"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\nvt 0.5 0.5\nvt 0.25 0.25\n"
+			"f 1/1 2/2 3/3\nf 1/5 3/6 4/4\n" };
+
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		ASSERT_TRUE(Utils::ParseOBJ(obj.GetPath(), vertices, indices, false));
+		ASSERT_EQ(vertices.size(), 6u);
+		ASSERT_EQ(indices.size(), 6u);
+		EXPECT_NE(indices[0], indices[3]);
+		EXPECT_NE(indices[2], indices[4]);
+		EXPECT_TRUE(IsSame(vertices[indices[0]].position, vertices[indices[3]].position));
+		EXPECT_FALSE(IsSame(vertices[indices[0]].uv, vertices[indices[3]].uv));
+	}
+
+	TEST(ParseOBJ, NegativeIndicesResolve)
+	{
+		const TempFile absolute{ "dae_test_absolute.obj",
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvt 1 0\nvt 0 1\nf 1/1 2/2 3/3\n"
+			"v 2 0 0\nv 3 0 0\nv 2 1 0\nvt 0.5 0\nvt 1 0.5\nvt 0 0.5\nf 4/4 5/5 6/6\n" };
+		const TempFile relative{ "dae_test_relative.obj",
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvt 1 0\nvt 0 1\nf -3/-3 -2/-2 -1/-1\n"
+			"v 2 0 0\nv 3 0 0\nv 2 1 0\nvt 0.5 0\nvt 1 0.5\nvt 0 0.5\nf -3/-3 -2/-2 -1/-1\n" };
+
+		std::vector<Vertex> absoluteVertices{}, relativeVertices{};
+		std::vector<uint32_t> absoluteIndices{}, relativeIndices{};
+		ASSERT_TRUE(Utils::ParseOBJ(absolute.GetPath(), absoluteVertices, absoluteIndices));
+		ASSERT_TRUE(Utils::ParseOBJ(relative.GetPath(), relativeVertices, relativeIndices));
+		ASSERT_EQ(relativeVertices.size(), 6u);
+		EXPECT_EQ(relativeIndices, absoluteIndices);
+		for (size_t i{}; i < relativeVertices.size(); ++i)
+		{
+			EXPECT_TRUE(IsSame(relativeVertices[i].position, absoluteVertices[i].position));
+			EXPECT_TRUE(IsSame(relativeVertices[i].uv, absoluteVertices[i].uv));
+		}
+	}
+
+	TEST(ParseOBJ, SerialAndPooledParsesMatch)
+	{
+		//big enough to be split into chunks, with relative indices that reach back into the chunk before
+		constexpr int gridSize{ 160 };
+		std::string contents{};
+		for (int y{}; y <= gridSize; ++y)
+		{
+			for (int x{}; x <= gridSize; ++x)
+			{
+				contents += "v " + std::to_string(x * 0.25f) + " " + std::to_string(y * 0.25f) + " " + std::to_string(std::sin(x * 0.1f + y * 0.2f)) + "\n";
+				contents += "vt " + std::to_string(float(x) / gridSize) + " " + std::to_string(float(y) / gridSize) + "\n";
+				contents += "vn 0 0 1\n";
+			}
+		}
+		const int rowLength{ gridSize + 1 };
+		for (int y{}; y < gridSize; ++y)
+		{
+			for (int x{}; x < gridSize; ++x)
+			{
+				const int corner{ y * rowLength + x + 1 };
+				const int corners[4]{ corner, corner + 1, corner + rowLength + 1, corner + rowLength };
+				contents += "f";
+				for (int c : corners)
+				{
+					//every other quad counts back from the end
+					const int index{ (x + y) % 2 == 0 ? c : c - rowLength * rowLength - 1 };
+					contents += " " + std::to_string(index) + "/" + std::to_string(index) + "/" + std::to_string(index);
+				}
+				contents += "\n";
+			}
+		}
+		ASSERT_GT(contents.size(), size_t(4 * 256 * 1024));
+		const TempFile obj{ "dae_test_grid.obj", contents };
+
+		std::vector<Vertex> serialVertices{}, pooledVertices{};
+		std::vector<uint32_t> serialIndices{}, pooledIndices{};
+		ThreadPool pool{ 4 };
+		ASSERT_TRUE(Utils::ParseOBJ(obj.GetPath(), serialVertices, serialIndices, true, nullptr));
+		ASSERT_TRUE(Utils::ParseOBJ(obj.GetPath(), pooledVertices, pooledIndices, true, &pool));
+
+		EXPECT_EQ(serialVertices.size(), size_t(rowLength * rowLength));
+		EXPECT_EQ(serialIndices.size(), size_t(gridSize * gridSize * 6));
+		EXPECT_EQ(pooledIndices, serialIndices);
+		ASSERT_EQ(pooledVertices.size(), serialVertices.size());
+		EXPECT_EQ(std::memcmp(pooledVertices.data(), serialVertices.data(), serialVertices.size() * sizeof(Vertex)), 0);
+	}
+
+	TEST(ParseOBJ, TangentWithoutUvAreaIsPerpendicular)
+	{
+		//all three corners share a uv, no face gives these vertices a tangent
+		const TempFile obj{ "dae_test_nouv.obj",
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 1\nvt 0.5 0.5\nvn 0 0 1\nvn 1 0 0\nvn 0 0 0\n"
+			"f 1/1/1 2/1/1 3/1/1\nf 2/1/2 4/1/2 3/1/2\nf 1/1/3 2/1/3 4/1/3\n" };
+
+		std::vector<Vertex> vertices{};
+		std::vector<uint32_t> indices{};
+		ASSERT_TRUE(Utils::ParseOBJ(obj.GetPath(), vertices, indices));
+		ASSERT_EQ(vertices.size(), 9u);
+		for (const Vertex& vertex : vertices)
+		{
+			EXPECT_TRUE(IsUnitAndFinite(vertex.tangent));
+			EXPECT_NEAR(Vector3::Dot(vertex.tangent, vertex.normal), 0.f, 1e-6f);
+		}
+	}
+
+	namespace
+	{
+		//a packed mesh and the source file it claims to come from
+		struct CacheFixture
+		{
+			TempFile source{ "dae_test_cache_source.obj", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n" };
+			TempFile cache{ "dae_test_cache.mesh", "" };
+			VertexInStream vertices{};
+			VertexQuantization quantization{};
+			std::vector<uint32_t> indices{};
+
+			CacheFixture()
+			{
+				PackVertices(MakeDirectionVertices(MakeTestDirections()), vertices, quantization);
+				for (uint32_t i{}; i + 2 < vertices.GetCount(); ++i)
+				{
+					indices.insert(indices.end(), { i, i + 2, i + 1 });
+				}
+			}
+		};
+
+		//the header starts with an 8 byte magic and the 4 byte version
+		void OverwriteVersion(const std::string& path, uint32_t version)
+		{
+			std::fstream file{ path, std::ios::binary | std::ios::in | std::ios::out };
+			file.seekp(8);
+			file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+		}
+	}
+
+	TEST(MeshCache, RoundTrip)
+	{
+		const CacheFixture fixture{};
+		ASSERT_TRUE(MeshCache::Write(fixture.cache.GetPath(), fixture.source.GetPath(), fixture.vertices, fixture.quantization, fixture.indices, PrimitiveTopology::TriangleStrip));
+
+		const MeshCache cache{ fixture.cache.GetPath(), fixture.source.GetPath() };
+		ASSERT_TRUE(cache.IsValid());
+		EXPECT_EQ(cache.GetPrimitiveTopology(), PrimitiveTopology::TriangleStrip);
+		EXPECT_EQ(std::memcmp(&cache.GetQuantization(), &fixture.quantization, sizeof(VertexQuantization)), 0);
+
+		VertexInStream mapped{};
+		cache.ViewVertices(mapped);
+		ASSERT_EQ(mapped.GetCount(), fixture.vertices.GetCount());
+		for (int component{}; component < VertexInLayout::ComponentCount; ++component)
+		{
+			EXPECT_EQ(std::memcmp(mapped.Get(component), fixture.vertices.Get(component), mapped.GetCount() * sizeof(VertexInLayout::Element)), 0) << "component " << component;
+		}
+
+		ASSERT_EQ(cache.GetIndexCount(), fixture.indices.size());
+		EXPECT_EQ(std::vector<uint32_t>(cache.GetIndices(), cache.GetIndices() + cache.GetIndexCount()), fixture.indices);
+	}
+
+	TEST(MeshCache, OtherVersionIsInvalid)
+	{
+		const CacheFixture fixture{};
+		ASSERT_TRUE(MeshCache::Write(fixture.cache.GetPath(), fixture.source.GetPath(), fixture.vertices, fixture.quantization, fixture.indices, PrimitiveTopology::TriangleList));
+		OverwriteVersion(fixture.cache.GetPath(), MeshCache::Version + 1);
+		EXPECT_FALSE(MeshCache(fixture.cache.GetPath(), fixture.source.GetPath()).IsValid());
+		OverwriteVersion(fixture.cache.GetPath(), MeshCache::Version);
+		EXPECT_TRUE(MeshCache(fixture.cache.GetPath(), fixture.source.GetPath()).IsValid());
+	}
+
+	TEST(MeshCache, ChangedSourceIsInvalid)
+	{
+		const CacheFixture fixture{};
+		ASSERT_TRUE(MeshCache::Write(fixture.cache.GetPath(), fixture.source.GetPath(), fixture.vertices, fixture.quantization, fixture.indices, PrimitiveTopology::TriangleList));
+		{
+			std::ofstream source{ fixture.source.GetPath(), std::ios::binary | std::ios::app };
+			source << "f 3 2 1\n";
+		}
+		EXPECT_FALSE(MeshCache(fixture.cache.GetPath(), fixture.source.GetPath()).IsValid());
+	}
+
+	TEST(MeshCache, OutOfRangeContentsAreInvalid)
+	{
+		CacheFixture fixture{};
+		ASSERT_TRUE(MeshCache::Write(fixture.cache.GetPath(), fixture.source.GetPath(), fixture.vertices, fixture.quantization, fixture.indices, static_cast<PrimitiveTopology>(2)));
+		EXPECT_FALSE(MeshCache(fixture.cache.GetPath(), fixture.source.GetPath()).IsValid());
+
+		fixture.indices.back() = uint32_t(fixture.vertices.GetCount());
+		ASSERT_TRUE(MeshCache::Write(fixture.cache.GetPath(), fixture.source.GetPath(), fixture.vertices, fixture.quantization, fixture.indices, PrimitiveTopology::TriangleList));
+		EXPECT_FALSE(MeshCache(fixture.cache.GetPath(), fixture.source.GetPath()).IsValid());
+	}
 }